@@ -11,7 +11,9 @@
 #include "blurconfig.h"
 
 #include "blur_cache.hpp"
+#include "blur_profile.hpp"
 #include "kwin_compat.hpp"
+#include "memory_pressure_monitor.hpp"
 #include "refraction_pass.hpp"
 #include "rounded_corners_pass.hpp"
 #include "settings.hpp"
@@ -57,6 +59,7 @@
 #include <QGuiApplication>
 #include <QMatrix4x4>
 #include <QScreen>
+#include <QSet>
 #include <QTime>
 #include <QTimer>
 #include <QWindow>
@@ -85,6 +88,41 @@ namespace BBDX {
 using namespace KWin;
 
 static const QByteArray s_blurAtomName = QByteArrayLiteral("_KDE_NET_WM_BLUR_BEHIND_REGION");
+// BBDX: "static", "low-rate" or "live" (see BBDX::Window::UpdateHint)
+static const QByteArray s_blurHintAtomName = QByteArrayLiteral("_BBDX_NET_WM_BLUR_BEHIND_HINT");
+
+// BBDX: settings changing which windows are blurred and how
+static const QSet<QString> s_windowConfigKeys{
+    QStringLiteral("CornerRadius"),
+    QStringLiteral("WindowClasses"),
+    QStringLiteral("BlurMatching"),
+    QStringLiteral("BlurNonMatching"),
+    QStringLiteral("BlurDecorations"),
+    QStringLiteral("BlurMenus"),
+    QStringLiteral("BlurDocks"),
+};
+
+// BBDX: settings changing what the cached blur looks like
+static const QSet<QString> s_blurConfigKeys{
+    QStringLiteral("BlurStrength"),
+    QStringLiteral("NoiseStrength"),
+    QStringLiteral("Brightness"),
+    QStringLiteral("Saturation"),
+    QStringLiteral("Contrast"),
+    QStringLiteral("ForceContrastParams"),
+    QStringLiteral("RefractionStrength"),
+    QStringLiteral("RefractionMode"),
+    QStringLiteral("RefractionEdgeSize"),
+    QStringLiteral("RefractionNormalPow"),
+    QStringLiteral("RefractionCornerRadius"),
+    QStringLiteral("RefractionRGBFringing"),
+    QStringLiteral("RefractionTextureRepeatMode"),
+    QStringLiteral("BlitMode"),
+};
+
+// BBDX: number of blur pyramids (re)allocated per frame
+// while rebuilding after GPU resources were released
+static constexpr size_t s_rebuildAllocationsPerFrame = 2;
 
 #if !defined(BBDX_X11) && KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 90)
 BlurManagerInterface *BlurEffect::s_blurManager = nullptr;
@@ -219,11 +257,18 @@ BlurEffect::BlurEffect()
         return;
     }
 
+    m_memoryPressureMonitor = BBDX::MemoryPressureMonitor::create();
+    connect(m_memoryPressureMonitor.get(), &BBDX::MemoryPressureMonitor::levelChanged, this, &BlurEffect::slotMemoryPressureChanged);
+
+    m_powerProfileMonitor = BBDX::PowerProfileMonitor::create();
+    connect(m_powerProfileMonitor.get(), &BBDX::PowerProfileMonitor::powerSavingChanged, this, &BlurEffect::slotPowerSavingChanged);
+
     initBlurStrengthValues();
     reconfigure(ReconfigureAll);
 
     if (effects->xcbConnection()) {
         net_wm_blur_region = effects->announceSupportProperty(s_blurAtomName, this);
+        net_wm_blur_hint = effects->announceSupportProperty(s_blurHintAtomName, this);
     }
 
 #if !defined(BBDX_X11) && KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 90)
@@ -266,8 +311,15 @@ BlurEffect::BlurEffect()
     connect(effects, &EffectsHandler::viewRemoved, this, &BlurEffect::slotViewRemoved);
 #endif
     connect(effects, &EffectsHandler::propertyNotify, this, &BlurEffect::slotPropertyNotify);
+    connect(effects, &EffectsHandler::screenLockingChanged, this, &BlurEffect::slotScreenLockingChanged);
+    connect(effects, &EffectsHandler::screenAdded, this, &BlurEffect::slotScreenAdded);
+    connect(effects, &EffectsHandler::screenRemoved, this, &BlurEffect::slotScreenRemoved);
+    for (LogicalOutput *output : effects->screens()) {
+        slotScreenAdded(output);
+    }
     connect(effects, &EffectsHandler::xcbConnectionChanged, this, [this]() {
         net_wm_blur_region = effects->announceSupportProperty(s_blurAtomName, this);
+        net_wm_blur_hint = effects->announceSupportProperty(s_blurHintAtomName, this);
     });
 
     // Fetch the blur regions for all windows
@@ -357,10 +409,30 @@ void BlurEffect::reconfigure(ReconfigureFlags flags)
 {
     Q_UNUSED(flags);
     BlurConfig::self()->read();
+
+    // BBDX: only redo what the changed settings affect
+    QSet<QString> changedKeys;
+    for (const KConfigSkeletonItem *item : BlurConfig::self()->items()) {
+        const QVariant value = item->property();
+        if (const auto it = m_configValues.constFind(item->name()); it == m_configValues.cend() || *it != value) {
+            changedKeys.insert(item->name());
+            m_configValues.insert(item->name(), value);
+        }
+    }
+    const bool wasPowerSaving = powerSaving();
+
+    // power saving decides on the overrides below
+    m_powerProfileMonitor->reconfigure();
     m_refractionPass->reconfigure();
+    m_refractionPass->setSuspended(powerSaving());
     m_windowManager->reconfigure();
     m_blurCache->reconfigure();
+    m_memoryPressureMonitor->reconfigure();
+    m_dynamicResolution.reconfigure();
+    m_outputRefresh.reconfigure();
     m_forceContrastParams = BlurConfig::forceContrastParams();
+    m_blurBudgetWindows = BlurConfig::blurBudgetWindows();
+    m_blurBudgetAreaThreshold = BlurConfig::blurBudgetAreaThreshold() / 100.0;
 
     int blurStrength = BlurConfig::blurStrength() - 1;
     m_iterationCount = blurStrengthValues[blurStrength].iteration;
@@ -376,12 +448,28 @@ void BlurEffect::reconfigure(ReconfigureFlags flags)
     }
 #endif
 
-    for (EffectWindow *w : effects->stackingOrder()) {
-        updateBlurRegion(w);
+    // BBDX: rate limits, budgets etc. only affect future flushes
+    const bool windowsChanged = changedKeys.intersects(s_windowConfigKeys);
+    const bool blurChanged = changedKeys.intersects(s_blurConfigKeys) || powerSaving() != wasPowerSaving;
+
+    if (windowsChanged) {
+        m_windowManager->reconfigureWindows();
+
+        for (EffectWindow *w : effects->stackingOrder()) {
+            updateBlurRegion(w);
+        }
+    }
+
+    // the cached blur has strength, colors and source baked in,
+    // new pyramids are allocated on their own if their size changed
+    if (blurChanged) {
+        m_windowManager->invalidateAllBlurCaches(static_cast<uint>(BBDX::BlurCacheInvalidationFlag::REGION), "Blur settings changed");
     }
 
     // Update all windows for the blur to take effect
-    effects->addRepaintFull();
+    if (windowsChanged || blurChanged) {
+        effects->addRepaintFull();
+    }
 }
 
 void BlurEffect::updateBlurRegion(EffectWindow *w)
@@ -464,6 +552,7 @@ void BlurEffect::updateBlurRegion(EffectWindow *w)
 
     // BBDX:
     m_windowManager->getFinalBlurRegion(w, content, frame);
+    m_windowManager->invalidateBlurCoverage();
 
     if (content.has_value() || frame.has_value()) {
         BlurEffectData &data = m_windows[w];
@@ -485,7 +574,8 @@ void BlurEffect::updateBlurRegion(EffectWindow *w)
             data.blurItem = std::make_unique<BackgroundEffectItem>(w->windowItem());
         }
         data.blurItem->setPixelsToExpandRepaintsBelowOpaqueRegions(m_expandSize);
-        data.blurItem->setEffectBoundingRect(blurRegion(w).boundingRect());
+        // BBDX: nothing below a covered blur needs repainting for it
+        data.blurItem->setEffectBoundingRect(m_windowManager->windowIsBlurFullyCovered(w) ? RectF() : blurRegion(w).boundingRect());
 #endif
     } else {
         if (auto it = m_windows.find(w); it != m_windows.end()) {
@@ -495,6 +585,31 @@ void BlurEffect::updateBlurRegion(EffectWindow *w)
     }
 }
 
+void BlurEffect::updateBlurHint(EffectWindow *w)
+{
+    QString value;
+
+    if (net_wm_blur_hint != XCB_ATOM_NONE) {
+#if KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 90)
+        value = QString::fromLatin1(w->readProperty(net_wm_blur_hint, XCB_ATOM_STRING, 8));
+#else
+        if (const auto x11Window = qobject_cast<X11Window *>(w->window())) {
+            Xcb::Property hintProperty(false, x11Window->window(), net_wm_blur_hint, XCB_ATOM_STRING, 0, 32);
+            value = QString::fromLatin1(hintProperty.toByteArray());
+        }
+#endif
+    }
+
+    if (auto internal = w->internalWindow()) {
+        const auto property = internal->property("kwin_blur_hint");
+        if (property.isValid()) {
+            value = property.toString();
+        }
+    }
+
+    m_windowManager->setWindowUpdateHint(w, BBDX::Window::updateHintFromString(value.trimmed()));
+}
+
 void BlurEffect::slotWindowAdded(EffectWindow *w)
 {
     SurfaceInterface *surf = w->surface();
@@ -524,14 +639,22 @@ void BlurEffect::slotWindowAdded(EffectWindow *w)
     });
 
     updateBlurRegion(w);
+    updateBlurHint(w);
 }
 
 void BlurEffect::slotWindowDeleted(EffectWindow *w)
 {
     if (auto it = m_windows.find(w); it != m_windows.end()) {
         effects->makeOpenGLContextCurrent();
+        // BBDX: keep popup resources around for the next one
+        if (BlurCache::isTombstoneCandidate(w)) {
+            for (auto &[view, renderData] : it->second.render) {
+                m_blurCache->buryRenderData(w, view, renderData);
+            }
+        }
         m_windows.erase(it);
     }
+    m_blurDependencies.dropWindow(w);
     if (auto it = windowBlurChangedConnections.find(w); it != windowBlurChangedConnections.end()) {
         disconnect(*it);
         windowBlurChangedConnections.erase(it);
@@ -553,8 +676,236 @@ void BlurEffect::slotViewRemoved(KWin::RenderView *view)
         }
     }
 
-    // BBDX: cleanup wallpaper
+    // BBDX: cleanup wallpaper and tombstones
     m_blurCache->dropWallpaper(view);
+    m_blurCache->dropTombstones(view);
+    m_dynamicResolution.dropView(view);
+    m_outputRefresh.dropView(view);
+    m_blurDependencies.dropView(view);
+    m_suspendedViews.erase(view);
+    m_overBudgetWindows.erase(view);
+}
+
+void BlurEffect::slotScreenLockingChanged(bool locked)
+{
+    updateGPUResourceState(locked);
+}
+
+void BlurEffect::slotScreenAdded(KWin::LogicalOutput *output)
+{
+    m_outputDpmsConnections[output] = BBDX::connectOutputDpmsChanged(output, this, [this]() {
+        updateGPUResourceState(effects->isScreenLocked());
+    });
+}
+
+void BlurEffect::slotScreenRemoved(KWin::LogicalOutput *output)
+{
+    if (auto it = m_outputDpmsConnections.find(output); it != m_outputDpmsConnections.end()) {
+        disconnect(it->second);
+        m_outputDpmsConnections.erase(it);
+    }
+}
+
+void BlurEffect::slotMemoryPressureChanged(BBDX::MemoryPressureMonitor::Level level)
+{
+    qCDebug(KWIN_BLUR) << BBDX::LOG_PREFIX << "Memory pressure level:" << level;
+
+    // pyramids of windows that aren't visible
+    // are only needed again once they are shown
+    if (level != BBDX::MemoryPressureMonitor::Level::None) {
+        effects->makeOpenGLContextCurrent();
+        for (auto &[window, data] : m_windows) {
+            if (window->isMinimized() || !window->isOnCurrentDesktop()) {
+                data.render.clear();
+            }
+        }
+    }
+
+    m_blurCache->setMemoryPressure(level);
+    effects->addRepaintFull();
+}
+
+void BlurEffect::slotPowerSavingChanged(bool powerSaving)
+{
+    qCDebug(KWIN_BLUR) << BBDX::LOG_PREFIX << "Power saving:" << powerSaving;
+
+    // overrides are applied on top of the user settings
+    // so a plain reconfigure applies/restores them
+    // (the settings themselves didn't change, re-blur explicitly)
+    reconfigure(ReconfigureAll);
+    m_windowManager->invalidateAllBlurCaches(static_cast<uint>(BBDX::BlurCacheInvalidationFlag::REGION), "Power saving changed");
+    effects->addRepaintFull();
+}
+
+bool BlurEffect::updateViewSuspension(RenderView *view)
+{
+    const bool covered = m_windowManager->viewIsCoveredByFullscreen(view);
+    const bool suspended = m_suspendedViews.contains(view);
+    if (covered == suspended) {
+        return covered;
+    }
+
+    if (covered) {
+        qCDebug(KWIN_BLUR) << BBDX::LOG_PREFIX << "Suspending blur on view covered by a fullscreen window";
+        m_suspendedViews.insert(view);
+
+        // pyramids are reallocated on demand, caches are kept
+        // so blurred windows show up instantly once uncovered
+        effects->makeOpenGLContextCurrent();
+        for (auto &[window, data] : m_windows) {
+            if (auto it = data.render.find(view); it != data.render.end()) {
+                it->second.textures.clear();
+                it->second.framebuffers.clear();
+            }
+        }
+        return true;
+    }
+
+    // the pyramid reallocation marks each cache for one flush
+    qCDebug(KWIN_BLUR) << BBDX::LOG_PREFIX << "Resuming blur on view";
+    m_suspendedViews.erase(view);
+    effects->addRepaintFull();
+    return false;
+}
+
+void BlurEffect::updateBlurBudget(RenderView *view)
+{
+    auto &overBudget = m_overBudgetWindows[view];
+    overBudget.clear();
+
+    if (m_blurBudgetWindows <= 0) {
+        return;
+    }
+
+#if defined(BBDX_X11)
+    const LogicalOutput *output = view;
+#else
+    const LogicalOutput *output = view->logicalOutput();
+#endif
+    const Rect outputRect{output->geometry()};
+    const qreal areaThreshold = qreal(outputRect.width()) * outputRect.height() * m_blurBudgetAreaThreshold;
+
+    // top to bottom, opaque windows hide whatever is below them
+    std::vector<std::pair<const EffectWindow *, qreal>> blurred{};
+    Region covered;
+    const auto stackingOrder = effects->stackingOrder();
+    for (auto it = stackingOrder.crbegin(); it != stackingOrder.crend(); ++it) {
+        EffectWindow *w = *it;
+        if (!w->isVisible() || !w->isOnCurrentDesktop() || w->isMinimized()) {
+            continue;
+        }
+
+        const Rect windowRect{Rect(w->frameGeometry().toRect())};
+        if (!windowRect.intersects(outputRect)) {
+            continue;
+        }
+
+        if (m_windowManager->windowIsBlurred(w)) {
+            const Rect blurRect{Rect(QRectF(blurRegion(w).boundingRect()).translated(w->pos()).toAlignedRect())};
+            const Region visible = Region(blurRect.intersected(outputRect)) - covered;
+
+            qreal area{0.0};
+            for (const Rect &rect : visible.rects()) {
+                area += qreal(rect.width()) * rect.height();
+            }
+            blurred.emplace_back(w, area);
+        }
+
+        // most clients use ARGB buffers, only the
+        // surface's opaque region really hides what's below
+        covered += m_windowManager->windowOpaqueRegion(w);
+    }
+
+    if (blurred.size() <= size_t(m_blurBudgetWindows)) {
+        return;
+    }
+
+    std::ranges::stable_sort(blurred, [](const auto &a, const auto &b) {
+        return a.second > b.second;
+    });
+
+    for (size_t i = m_blurBudgetWindows; i < blurred.size(); ++i) {
+        const auto &[w, area] = blurred[i];
+        if (m_blurBudgetAreaThreshold > 0.0 && area >= areaThreshold) {
+            continue;
+        }
+        overBudget.insert(w);
+    }
+}
+
+bool BlurEffect::windowHasVideoDamage(const EffectWindow *w, const RenderView *view) const
+{
+    auto it = m_windows.find(const_cast<EffectWindow *>(w));
+    if (it == m_windows.end()) {
+        return false;
+    }
+
+    auto renderIt = it->second.render.find(const_cast<RenderView *>(view));
+    if (renderIt == it->second.render.end() || !renderIt->second.cache) {
+        return false;
+    }
+
+    return renderIt->second.cache->hasVideoDamage();
+}
+
+BBDX::EffectiveBlur BlurEffect::effectiveBlur(const BBDX::BlurProfile &profile, const RenderView *view) const
+{
+    // dynamic resolution scaling shrinks the whole pyramid,
+    // the offset shrinks along to keep the blur's look
+    const qreal resolutionScale = m_dynamicResolution.scale(view) * profile.resolutionScale;
+
+    return BBDX::EffectiveBlur{
+        .iterationCount = std::max<size_t>(1, m_iterationCount - std::min(profile.iterationReduction, m_iterationCount)),
+        .resolutionScale = resolutionScale,
+        .offset = float(m_offset * resolutionScale),
+    };
+}
+
+bool BlurEffect::windowIsOverBlurBudget(const EffectWindow *w, const RenderView *view) const
+{
+    if (auto it = m_overBudgetWindows.find(view); it != m_overBudgetWindows.end()) {
+        return it->second.contains(w);
+    }
+
+    return false;
+}
+
+void BlurEffect::updateGPUResourceState(bool locked)
+{
+    const auto outputs = effects->screens();
+    const bool outputsOff = !outputs.isEmpty() && std::ranges::none_of(outputs, [](const LogicalOutput *output) {
+        return BBDX::outputIsPoweredOn(output);
+    });
+
+    const bool release = locked || outputsOff;
+    if (release == m_gpuResources.released) {
+        return;
+    }
+    m_gpuResources.released = release;
+
+    if (release) {
+        releaseGPUResources(locked ? "screen locked" : "outputs powered off");
+        return;
+    }
+
+    qCDebug(KWIN_BLUR) << BBDX::LOG_PREFIX << "Rebuilding GPU resources";
+    m_gpuResources.rebuilding = true;
+    m_gpuResources.rebuildStarted = false;
+    effects->addRepaintFull();
+}
+
+void BlurEffect::releaseGPUResources(const char *reason)
+{
+    qCDebug(KWIN_BLUR) << BBDX::LOG_PREFIX << "Releasing GPU resources:" << reason;
+
+    effects->makeOpenGLContextCurrent();
+    for (auto &[window, data] : m_windows) {
+        data.render.clear();
+    }
+    m_noisePass.noiseTexture.reset();
+    m_blurCache->releaseResources();
+
+    m_gpuResources.rebuilding = false;
 }
 
 void BlurEffect::slotPropertyNotify(EffectWindow *w, long atom)
@@ -562,6 +913,9 @@ void BlurEffect::slotPropertyNotify(EffectWindow *w, long atom)
     if (w && atom == net_wm_blur_region && net_wm_blur_region != XCB_ATOM_NONE) {
         updateBlurRegion(w);
     }
+    if (w && atom == net_wm_blur_hint && net_wm_blur_hint != XCB_ATOM_NONE) {
+        updateBlurHint(w);
+    }
 }
 
 void BlurEffect::setupDecorationConnections(EffectWindow *w)
@@ -584,6 +938,10 @@ bool BlurEffect::eventFilter(QObject *watched, QEvent *event)
             if (auto w = effects->findWindow(internal)) {
                 updateBlurRegion(w);
             }
+        } else if (pe->propertyName() == "kwin_blur_hint") {
+            if (auto w = effects->findWindow(internal)) {
+                updateBlurHint(w);
+            }
         }
     }
     return false;
@@ -703,13 +1061,54 @@ void BlurEffect::prePaintScreen(ScreenPrePaintData &data)
     m_currentView = data.view;
 #endif
 
-    m_blurCache->flushAccumulatedDirtyRegions(data);
+    const bool viewSuspended = updateViewSuspension(m_currentView);
+    if (!viewSuspended) {
+        m_dynamicResolution.beginFrame(m_currentView);
+    }
+    m_outputRefresh.beginFrame(m_currentView);
+
+    // BBDX: the lazy rebuild is done once a frame
+    // got through without running out of allocations
+    if (m_gpuResources.rebuilding) {
+        if (m_gpuResources.rebuildStarted && !m_gpuResources.rebuildDeferred) {
+            qCDebug(KWIN_BLUR) << BBDX::LOG_PREFIX << "Finished rebuilding GPU resources";
+            m_gpuResources.rebuilding = false;
+        }
+        m_gpuResources.rebuildStarted = true;
+        m_gpuResources.rebuildDeferred = false;
+        m_gpuResources.rebuildBudget = s_rebuildAllocationsPerFrame;
+    }
+
+    m_blurCache->pruneTombstones();
+    m_windowManager->advanceDesktopSwitchPrewarm(m_outputRefresh.refreshInterval(m_currentView));
+    if (!viewSuspended) {
+        m_windowManager->updateBlurCoverage();
+        updateBlurBudget(m_currentView);
+        m_blurCache->flushAccumulatedDirtyRegions(data);
+    }
 
 #if KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 90)
     effects->prePaintScreen(data, presentTime);
 #else
     effects->prePaintScreen(data);
 #endif
+
+    // BBDX: what actually changed this frame
+    // before repaints get expanded for blur
+    if (!viewSuspended) {
+        m_blurDependencies.setFrameDamage(m_currentView, data.paint);
+    }
+}
+
+void BlurEffect::postPaintScreen()
+{
+    // BBDX: the pyramids pick up a new scale lazily
+    // but every blurred window needs a repaint for that
+    if (!m_suspendedViews.contains(m_currentView) && m_dynamicResolution.endFrame(m_currentView)) {
+        m_windowManager->repaintAllBlurredWindows();
+    }
+
+    effects->postPaintScreen();
 }
 
 #if KWIN_VERSION < KWIN_VERSION_CODE(6, 5, 80)
@@ -725,6 +1124,9 @@ void BlurEffect::prePaintWindow(RenderView *view, EffectWindow *w, WindowPrePain
 #if KWIN_VERSION < KWIN_VERSION_CODE(6, 5, 80)
     effects->prePaintWindow(w, data, presentTime);
 
+    // BBDX: what this window paints before it gets expanded for blur
+    m_blurDependencies.addWindowDamage(m_currentView, w, data.paint);
+
     const QRegion oldOpaque = data.opaque;
     if (data.opaque.intersects(m_currentDeviceBlur)) {
         // to blur an area partially we have to shrink the opaque area of a window
@@ -745,7 +1147,8 @@ void BlurEffect::prePaintWindow(RenderView *view, EffectWindow *w, WindowPrePain
     }
 
     // in case this window has regions to be blurred
-    const QRegion blurArea = blurRegion(w).boundingRect().translated(w->pos().toPoint());
+    // BBDX: unless it's fully covered anyways
+    const QRegion blurArea = m_windowManager->windowIsBlurFullyCovered(w) ? QRegion() : blurRegion(w).boundingRect().translated(w->pos().toPoint());
 
     // if this window or a window underneath the blurred area is painted again we have to
     // blur everything
@@ -765,6 +1168,9 @@ void BlurEffect::prePaintWindow(RenderView *view, EffectWindow *w, WindowPrePain
 #elif KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 4)
     effects->prePaintWindow(view, w, data, presentTime);
 
+    // BBDX: what this window paints before it gets expanded for blur
+    m_blurDependencies.addWindowDamage(m_currentView, w, view->mapFromDeviceCoordinatesAligned(data.devicePaint));
+
     const Region oldOpaque = data.deviceOpaque;
     if (data.deviceOpaque.intersects(m_currentDeviceBlur)) {
         // to blur an area partially we have to shrink the opaque area of a window
@@ -785,7 +1191,8 @@ void BlurEffect::prePaintWindow(RenderView *view, EffectWindow *w, WindowPrePain
     }
 
     // in case this window has regions to be blurred
-    const Region blurArea = view->mapToDeviceCoordinatesAligned(QRectF(blurRegion(w).boundingRect()).translated(w->pos()));
+    // BBDX: unless it's fully covered anyways
+    const Region blurArea = m_windowManager->windowIsBlurFullyCovered(w) ? Region() : view->mapToDeviceCoordinatesAligned(QRectF(blurRegion(w).boundingRect()).translated(w->pos()));
 
     // if this window or a window underneath the blurred area is painted again we have to
     // blur everything
@@ -814,8 +1221,10 @@ void BlurEffect::prePaintWindow(RenderView *view, EffectWindow *w, WindowPrePain
     // cull some areas leading to incomplete blits.
     //
     // Wallpaper mode does not need this because it
-    // doesn't rely on blitting
-    if (m_windowManager->windowIsBlurred(w) && m_blurCache->blitMode() != BlitMode::WALLPAPER) {
+    // doesn't rely on blitting, covered windows aren't blurred at all
+    if (m_windowManager->windowIsBlurred(w)
+        && m_blurCache->blitMode() != BlitMode::WALLPAPER
+        && !m_windowManager->windowIsBlurFullyCovered(w)) {
         data.setTranslucent();
     }
 }
@@ -892,6 +1301,34 @@ GLTexture *BlurEffect::ensureNoiseTexture()
     return m_noisePass.noiseTexture.get();
 }
 
+Region BlurEffect::opaqueSkipRegion(const EffectWindow *w, const WindowPaintData &data) const
+{
+    // only untransformed, fully opaque content actually hides the blur
+    if (data.opacity() < 1.0 || w->opacity() < 1.0) {
+        return Region();
+    }
+    if (data.xScale() != 1 || data.yScale() != 1 || data.xTranslation() || data.yTranslation()) {
+        return Region();
+    }
+
+    const SurfaceItem *surfaceItem = w->windowItem() ? w->windowItem()->surfaceItem() : nullptr;
+    if (!surfaceItem) {
+        return Region();
+    }
+
+    // pixels within m_expandSize of the translucent parts
+    // are still sampled by the kernel and have to stay
+    Region skipRegion;
+    for (const Rect &rect : surfaceItem->opaque().rects()) {
+        const Rect sceneRect = BBDX::rectRoundedIn(surfaceItem->mapToScene(RectF(rect)));
+        const Rect innerRect = sceneRect.adjusted(m_expandSize, m_expandSize, -m_expandSize, -m_expandSize);
+        if (!innerRect.isEmpty()) {
+            skipRegion += innerRect;
+        }
+    }
+    return skipRegion;
+}
+
 void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &viewport, EffectWindow *w, int mask, const Region &deviceRegion, WindowPaintData &data)
 {
     auto it = m_windows.find(w);
@@ -999,6 +1436,11 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
         return;
     }
 
+    // BBDX: reuse the resources of a recently closed popup
+    if (renderInfo.textures.empty() && BlurCache::isTombstoneCandidate(w)) {
+        m_blurCache->reviveRenderData(w, m_currentView, backgroundRect, renderInfo);
+    }
+
     // Maybe reallocate offscreen render targets. Keep in mind that the first one contains
     // original background behind the window, it's not blurred.
     GLenum textureFormat = GL_RGBA8;
@@ -1006,12 +1448,38 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
         textureFormat = renderTarget.texture()->internalFormat();
     }
 
-    if (renderInfo.framebuffers.size() != (m_iterationCount + 1) || renderInfo.textures[0]->size() != backgroundRect.size() || renderInfo.textures[0]->internalFormat() != textureFormat) {
+    // BBDX: per window quality profile
+    const BBDX::BlurProfile profile = m_windowManager->windowBlurProfile(w, m_currentView);
+    const BBDX::EffectiveBlur effective = effectiveBlur(profile, m_currentView);
+    const size_t iterationCount = effective.iterationCount;
+    const qreal resolutionScale = effective.resolutionScale;
+    const QSize blurTextureSize{std::max(1, qRound(backgroundRect.width() * resolutionScale)),
+                                std::max(1, qRound(backgroundRect.height() * resolutionScale))};
+    const float offset = effective.offset;
+
+    if (renderInfo.framebuffers.size() != (iterationCount + 1) || renderInfo.textures[0]->size() != blurTextureSize || renderInfo.textures[0]->internalFormat() != textureFormat) {
+        // BBDX: don't allocate anything while nothing is visible anyways
+        if (m_gpuResources.released) {
+            return;
+        }
+
+        // BBDX: spread allocations over multiple frames while rebuilding
+        // skipping the blur for this window until it gets its turn
+        if (m_gpuResources.rebuilding) {
+            if (m_gpuResources.rebuildBudget == 0) {
+                m_gpuResources.rebuildDeferred = true;
+                w->addRepaintFull();
+                return;
+            }
+            --m_gpuResources.rebuildBudget;
+        }
+
         renderInfo.framebuffers.clear();
         renderInfo.textures.clear();
-        // BBDX:
+        // BBDX: the cache entry itself is re-validated
+        // in preparePaintData(), only its content is outdated
         if (renderInfo.cache) {
-            renderInfo.cache->invalidate(static_cast<uint>(BlurCacheInvalidationFlag::FULL), "New framebuffers required");
+            renderInfo.cache->invalidate(static_cast<uint>(BlurCacheInvalidationFlag::REGION), "New framebuffers required");
         }
 
         // BBDX: alpha 1.0
@@ -1019,8 +1487,8 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
         // instead of transparent to avoid artifacts when dragging
         // windows across screen borders
         glClearColor(0.0, 0.0, 0.0, 1.0);
-        for (size_t i = 0; i <= m_iterationCount; ++i) {
-            auto texture = GLTexture::allocate(textureFormat, BBDX::getTextureSize(backgroundRect, i));
+        for (size_t i = 0; i <= iterationCount; ++i) {
+            auto texture = GLTexture::allocate(textureFormat, BBDX::getTextureSize(QRect(QPoint(), blurTextureSize), i));
             if (!texture) {
                 qCWarning(KWIN_BLUR) << BBDX::LOG_PREFIX << "Failed to allocate an offscreen texture";
                 return;
@@ -1043,10 +1511,28 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
 
     // Fetch the pixels behind the shape that is going to be blurred.
 #if KWIN_VERSION < KWIN_VERSION_CODE(6, 5, 80)
-    const QRegion dirtyRegion = deviceRegion & backgroundRect;
+    QRegion dirtyRegion = deviceRegion & backgroundRect;
 #else
-    const Region dirtyRegion = viewport.mapFromDeviceCoordinatesContained(deviceRegion) & backgroundRect;
+    Region dirtyRegion = viewport.mapFromDeviceCoordinatesContained(deviceRegion) & backgroundRect;
 #endif
+
+    // BBDX: nothing under the window's own opaque content is ever seen
+    // so it's neither blitted, blurred nor cached
+    const Region skipRegion = opaqueSkipRegion(w, data);
+    dirtyRegion -= skipRegion;
+
+    // previously skipped area became visible (e.g. content turned translucent)
+    // its blit and cache content is outdated
+    const Region localSkipRegion = skipRegion.translated(-w->pos().toPoint());
+    if (!(blurInfo.opaqueSkipRegion - localSkipRegion).isEmpty()) {
+        for (auto &[view, render] : blurInfo.render) {
+            if (render.cache) {
+                render.cache->invalidate(static_cast<uint>(BlurCacheInvalidationFlag::REGION), "Opaque region shrunk");
+            }
+        }
+        w->addRepaintFull();
+    }
+    blurInfo.opaqueSkipRegion = localSkipRegion;
 #if BBDX_NOT_NEEDED
     for (const Rect &dirtyRect : dirtyRegion.rects()) {
         renderInfo.framebuffers[0]->blitFromRenderTarget(renderTarget, viewport, dirtyRect, dirtyRect.translated(-backgroundRect.topLeft()));
@@ -1061,6 +1547,7 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
                                   renderInfo.framebuffers[0].get(),
                                   &backgroundRect,
                                   &scaledBackgroundRect,
+                                  &skipRegion,
                                   renderInfo.cache);
 
     if (!renderInfo.cache.get()) {
@@ -1180,6 +1667,24 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
         return;
     }
 
+    // BBDX: progressive flushes only run their share of the
+    // downsample, upsample and composite passes each frame
+    // (see BlurCache::preparePaintData() for when they are allowed)
+    const size_t passCount = 2 * (renderInfo.framebuffers.size() - 1);
+    const size_t passesPerFrame = m_blurCache->progressivePasses();
+    const auto [firstPass, endPass] = renderInfo.cache->advanceFlush(passesPerFrame, passCount);
+    size_t pass = 0;
+    const auto runsPass = [&pass, firstPass, endPass]() {
+        const size_t current = pass++;
+        return current >= firstPass && current < endPass;
+    };
+
+    // BBDX: measure the GPU cost of complete flushes
+    const bool timedFlush = firstPass == 0 && endPass == passCount;
+    if (timedFlush) {
+        renderInfo.cache->beginFlushTiming();
+    }
+
     // The downsample pass of the dual Kawase algorithm: the background will be scaled down 50% every iteration.
     {
         ShaderManager::instance()->pushShader(m_downsamplePass.shader.get());
@@ -1188,9 +1693,13 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
         projectionMatrix.ortho(QRectF(0.0, 0.0, backgroundRect.width(), backgroundRect.height()));
 
         m_downsamplePass.shader->setUniform(m_downsamplePass.mvpMatrixLocation, projectionMatrix);
-        m_downsamplePass.shader->setUniform(m_downsamplePass.offsetLocation, float(m_offset));
+        m_downsamplePass.shader->setUniform(m_downsamplePass.offsetLocation, offset);
 
         for (size_t i = 1; i < renderInfo.framebuffers.size(); ++i) {
+            if (!runsPass()) {
+                continue;
+            }
+
             // BBDX: read the blit from cache entry
             const GLFramebuffer *read;
             read = renderInfo.framebuffers[i - 1].get();
@@ -1203,8 +1712,11 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
             read->colorAttachment()->bind();
 
             GLFramebuffer::pushFramebuffer(draw.get());
-            BBDX::setGLScissor(dirtyRegion, backgroundRect);
-            vbo->draw(GL_TRIANGLES, 0, 6);
+            BBDX::drawGLScissored(m_blurCache->flushRegion(), backgroundRect, [vbo]() {
+                vbo->draw(GL_TRIANGLES, 0, 6);
+            });
+            // BBDX: balanced per pass so passes can end in any frame
+            GLFramebuffer::popFramebuffer();
         }
 
         ShaderManager::instance()->popShader();
@@ -1218,10 +1730,14 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
         projectionMatrix.ortho(QRectF(0.0, 0.0, backgroundRect.width(), backgroundRect.height()));
 
         m_upsamplePass.shader->setUniform(m_upsamplePass.mvpMatrixLocation, projectionMatrix);
-        m_upsamplePass.shader->setUniform(m_upsamplePass.offsetLocation, float(m_offset));
+        m_upsamplePass.shader->setUniform(m_upsamplePass.offsetLocation, offset);
 
         for (size_t i = renderInfo.framebuffers.size() - 1; i > 1; --i) {
-            GLFramebuffer::popFramebuffer();
+            if (!runsPass()) {
+                continue;
+            }
+
+            GLFramebuffer::pushFramebuffer(renderInfo.framebuffers[i - 1].get());
             const auto &read = renderInfo.framebuffers[i];
 
             const QVector2D halfpixel(0.5 / read->colorAttachment()->width(),
@@ -1230,8 +1746,10 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
 
             read->colorAttachment()->bind();
 
-            BBDX::setGLScissor(dirtyRegion, backgroundRect);
-            vbo->draw(GL_TRIANGLES, 0, 6);
+            BBDX::drawGLScissored(m_blurCache->flushRegion(), backgroundRect, [vbo]() {
+                vbo->draw(GL_TRIANGLES, 0, 6);
+            });
+            GLFramebuffer::popFramebuffer();
         }
 
         ShaderManager::instance()->popShader();
@@ -1244,6 +1762,21 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
 #endif
     const float modulation = opacity * opacity;
 
+    // BBDX: the composite is the last pass, until then
+    // the previous result stays on screen
+    if (!runsPass()) {
+        effects->addRepaint(backgroundRect);
+        m_blurCache->drawCached(viewport, renderInfo, vbo, vertexCount, modulation);
+        vbo->unbindArrays();
+        return;
+    }
+
+    // BBDX: render into the back buffer, the previous result
+    // stays on screen until the GPU is done with it
+    const bool asyncFlush = profile.asyncFlush
+                            && m_blurCache->asyncFlushAllowed(renderInfo.cache.get())
+                            && renderInfo.cache->beginAsyncFlush();
+
 #if BBDX_NOT_NEEDED
     if (const BorderRadius cornerRadius = w->window()->borderRadius(); !cornerRadius.isNull()) {
         ShaderManager::instance()->pushShader(m_roundedOnscreenPass.shader.get());
@@ -1297,7 +1830,6 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
         QMatrix4x4 projectionMatrix;
         projectionMatrix.ortho(QRectF(0.0, 0.0, backgroundRect.width(), backgroundRect.height()));
 
-        GLFramebuffer::popFramebuffer();
         const auto &read = renderInfo.framebuffers[1];
 
         const QVector2D halfpixel(0.5 / read->colorAttachment()->width(),
@@ -1306,12 +1838,12 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
         if (!m_refractionPass->setParameters(projectionMatrix,
                                              colorMatrix,
                                              halfpixel,
-                                             float(m_offset),
+                                             offset,
                                              backgroundRect)) {
         m_onscreenPass.shader->setUniform(m_onscreenPass.mvpMatrixLocation, projectionMatrix);
         m_onscreenPass.shader->setUniform(m_onscreenPass.colorMatrixLocation, colorMatrix);
         m_onscreenPass.shader->setUniform(m_onscreenPass.halfpixelLocation, halfpixel);
-        m_onscreenPass.shader->setUniform(m_onscreenPass.offsetLocation, float(m_offset));
+        m_onscreenPass.shader->setUniform(m_onscreenPass.offsetLocation, offset);
         } // indent intentional for KWin diff
 
         read->colorAttachment()->bind();
@@ -1376,6 +1908,14 @@ void BlurEffect::blur(const RenderTarget &renderTarget, const RenderViewport &vi
 
     // BBDX:
     m_roundedCornersPass->apply(m_windowManager.get(), backgroundRect, w, data, vbo, m_blurCache.get(), renderInfo.cache.get());
+    if (timedFlush) {
+        renderInfo.cache->endFlushTiming();
+    }
+    if (asyncFlush) {
+        renderInfo.cache->endAsyncFlush();
+        // swapped in by BlurCache::flushAccumulatedDirtyRegions()
+        effects->addRepaint(backgroundRect);
+    }
     m_blurCache->drawCached(viewport, renderInfo, vbo, vertexCount, modulation);
 
     vbo->unbindArrays();
@@ -8,9 +8,15 @@
 #pragma once
 
 #include "blur_cache.hpp"
+#include "blur_dependency_graph.hpp"
+#include "blur_profile.hpp"
 
 #include "kwin_compat.hpp"
 
+#include "dynamic_resolution.hpp"
+#include "memory_pressure_monitor.hpp"
+#include "output_refresh.hpp"
+#include "power_profile_monitor.hpp"
 #include "refraction_pass.hpp"
 #include "rounded_corners_pass.hpp"
 #include "window_manager.hpp"
@@ -34,10 +40,14 @@
 #endif
 #include <window.h>
 
+#include <QHash>
 #include <QList>
+#include <QString>
+#include <QVariant>
 
 #include <optional>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace KWin {
 #if KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 90)
@@ -58,7 +68,8 @@ struct BlurRenderData
     std::vector<std::unique_ptr<GLTexture>> textures;
     std::vector<std::unique_ptr<GLFramebuffer>> framebuffers;
 
-    std::unique_ptr<BBDX::BlurCacheEntry> cache;
+    // shared between views showing the same content (see BBDX::BlurCacheKey)
+    std::shared_ptr<BBDX::BlurCacheEntry> cache;
 };
 
 struct BlurEffectData
@@ -75,6 +86,10 @@ struct BlurEffectData
      */
     std::unordered_map<RenderView *, BlurRenderData> render;
 
+    /// BBDX: area (relative to the window position) skipped
+    /// last frame because the window's own content is opaque there
+    Region opaqueSkipRegion;
+
 #if KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 4)
     ItemEffect windowEffect;
 #else
@@ -104,6 +119,7 @@ public:
 #else
     void prePaintScreen(ScreenPrePaintData &data) override;
 #endif
+    void postPaintScreen() override;
 #if KWIN_VERSION < KWIN_VERSION_CODE(6, 5, 80)
     void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, std::chrono::milliseconds presentTime) override;
 #elif KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 90)
@@ -130,6 +146,11 @@ public Q_SLOTS:
     void slotWindowDeleted(KWin::EffectWindow *w);
     void slotViewRemoved(KWin::RenderView *view);
     void slotPropertyNotify(KWin::EffectWindow *w, long atom);
+    void slotScreenLockingChanged(bool locked);
+    void slotScreenAdded(KWin::LogicalOutput *output);
+    void slotScreenRemoved(KWin::LogicalOutput *output);
+    void slotMemoryPressureChanged(BBDX::MemoryPressureMonitor::Level level);
+    void slotPowerSavingChanged(bool powerSaving);
     void setupDecorationConnections(EffectWindow *w);
 
 private:
@@ -139,9 +160,26 @@ private:
     bool decorationSupportsBlurBehind(const EffectWindow *w) const;
     bool shouldBlur(const EffectWindow *w, int mask, const WindowPaintData &data) const;
     void updateBlurRegion(EffectWindow *w);
+    void updateBlurHint(EffectWindow *w);
     void blur(const RenderTarget &renderTarget, const RenderViewport &viewport, EffectWindow *w, int mask, const Region &deviceRegion, WindowPaintData &data);
     GLTexture *ensureNoiseTexture();
 
+    // BBDX: release/rebuild all GPU resources while nothing is visible
+    void updateGPUResourceState(bool locked);
+    void releaseGPUResources(const char *reason);
+
+    // BBDX: suspend all work on views covered by a fullscreen window
+    // returns whether view is suspended
+    bool updateViewSuspension(RenderView *view);
+
+    // BBDX: rank blurred windows on view by their visible blurred area
+    // and move everything outside the budget to m_overBudgetWindows
+    void updateBlurBudget(RenderView *view);
+
+    // BBDX: part of the blur shape hidden under the window's own opaque content
+    // shrunk by the kernel footprint so the visible blur still samples correct pixels
+    Region opaqueSkipRegion(const EffectWindow *w, const WindowPaintData &data) const;
+
 private:
     struct
     {
@@ -195,6 +233,7 @@ private:
 
     bool m_valid = false;
     long net_wm_blur_region = 0;
+    long net_wm_blur_hint = 0;
 #if KWIN_VERSION < KWIN_VERSION_CODE(6, 6, 4)
     Region m_paintedDeviceArea; // keeps track of all painted areas (from bottom to top)
     Region m_currentDeviceBlur; // keeps track of currently blurred area of the windows (from bottom to top)
@@ -242,19 +281,71 @@ private:
     // BBDX Mixins
     bool m_forceContrastParams{false};
 
+    /**
+     * GPU resources are released while the screen is locked
+     * or all outputs are powered off.
+     * Afterwards they are rebuilt lazily with a limited number
+     * of pyramid allocations per frame.
+     */
+    struct
+    {
+        bool released{false};
+        bool rebuilding{false};
+        bool rebuildStarted{false};
+        bool rebuildDeferred{false};
+        size_t rebuildBudget{0};
+    } m_gpuResources;
+    std::unordered_map<LogicalOutput *, QMetaObject::Connection> m_outputDpmsConnections;
+
+    /**
+     * Views covered by an opaque fullscreen window
+     * nothing blurred is visible there so all work is skipped
+     */
+    std::unordered_set<RenderView *> m_suspendedViews;
+
+    /**
+     * Only the m_blurBudgetWindows largest (by visible blurred area)
+     * and those covering more than m_blurBudgetAreaThreshold of
+     * an output get live blur, the rest keep their last cached result
+     */
+    int m_blurBudgetWindows{0};
+    qreal m_blurBudgetAreaThreshold{0.0};
+    std::unordered_map<const RenderView *, std::unordered_set<const EffectWindow *>> m_overBudgetWindows;
+
+    // BBDX: config values at the last reconfigure()
+    // to tell which settings changed
+    QHash<QString, QVariant> m_configValues;
+
     std::unique_ptr<BBDX::WindowManager> m_windowManager{};
     friend void BBDX::WindowManager::triggerBlurRegionUpdate(KWin::EffectWindow *w) const;
     friend void BBDX::WindowManager::invalidateBlurCache(KWin::EffectWindow *w, uint flags, const char *reason) const;
     friend void BBDX::WindowManager::flushWindowCaches(BBDX::Window *window) const;
+    friend void BBDX::WindowManager::forceFlushWindowCaches(BBDX::Window *window) const;
     friend void BBDX::WindowManager::flushWindowCachesFor(BBDX::Window *window, std::chrono::milliseconds duration) const;
     std::unique_ptr<BBDX::BlurCache> m_blurCache{};
-    friend void BBDX::BlurCache::flushAccumulatedDirtyRegions(KWin::ScreenPrePaintData &data) const;
+    friend class BBDX::BlurCache;
     std::unique_ptr<BBDX::RefractionPass> m_refractionPass{};
     std::unique_ptr<BBDX::RoundedCornersPass> m_roundedCornersPass{};
+    std::unique_ptr<BBDX::MemoryPressureMonitor> m_memoryPressureMonitor{};
+    std::unique_ptr<BBDX::PowerProfileMonitor> m_powerProfileMonitor{};
+    BBDX::DynamicResolution m_dynamicResolution{};
+    BBDX::OutputRefresh m_outputRefresh{};
+    BBDX::BlurDependencyGraph m_blurDependencies{};
 
 public:
     WindowManager* windowManager() const { return m_windowManager.get(); }
     BlurCache* blurCache() const { return m_blurCache.get(); }
+    int expandSize() const { return m_expandSize; }
+    const BBDX::OutputRefresh& outputRefresh() const { return m_outputRefresh; }
+    bool powerSaving() const { return m_powerProfileMonitor && m_powerProfileMonitor->powerSaving(); }
+    bool windowIsOverBlurBudget(const EffectWindow *w, const RenderView *view) const;
+    bool windowHasVideoDamage(const EffectWindow *w, const RenderView *view) const;
+
+    /**
+     * Iterations, resolution and offset the blur of a window
+     * with profile renders with on view
+     */
+    BBDX::EffectiveBlur effectiveBlur(const BBDX::BlurProfile &profile, const RenderView *view) const;
 };
 
 inline bool BlurEffect::provides(Effect::Feature feature)
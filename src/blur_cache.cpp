@@ -30,11 +30,74 @@
 #include <QVector2D>
 #include <QtNumeric>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <memory>
 
 Q_LOGGING_CATEGORY(BLUR_CACHE, "kwin_effect_better_blur_dx.blur_cache", QtInfoMsg)
 
+/**
+ * Limits for BlurCacheTombstones
+ *
+ * Popups are usually re-opened within a few seconds
+ * (or not at all) so there is no point in keeping
+ * their GPU memory around for longer
+ */
+static constexpr size_t s_maxTombstones{8};
+static constexpr std::chrono::milliseconds s_tombstoneLifetime{3000};
+
+/**
+ * Upper bound for flush intervals derived from the frame budget
+ * so even the most expensive entries keep up eventually
+ */
+static constexpr std::chrono::microseconds s_maxFlushInterval{250'000};
+
+/**
+ * Video-like damage: at least s_videoDamageFrames paints within
+ * s_videoDamageWindow each damaging s_videoDamageCoverage of an entry
+ *
+ * Entries return to normal after s_videoDamageCooldown without such damage
+ */
+static constexpr double s_videoDamageCoverage{0.25};
+static constexpr size_t s_videoDamageFrames{20};
+static constexpr std::chrono::milliseconds s_videoDamageWindow{1000};
+static constexpr std::chrono::milliseconds s_videoDamageCooldown{1000};
+
+/**
+ * Share of the blur kernel's footprint that has to be damaged
+ * before a periodic flush is worth it (one 8 bit colour step)
+ */
+static constexpr qreal s_significantDamage{1.0 / 255.0};
+
+/**
+ * Rough GPU cost of blurring one megapixel
+ * used for entries without a timer query measurement
+ */
+static constexpr std::chrono::microseconds s_estimatedCostPerMegapixel{500};
+
+
+/**
+ * Map a global rect to blitFramebuffer coordinates
+ * which may be down-scaled (dynamic resolution scaling)
+ */
+static inline KWin::Rect blitDestination(const KWin::Rect &rect,
+                                         const KWin::GLFramebuffer *blitFramebuffer,
+                                         const KWin::Rect &backgroundRect) {
+    const auto local = rect.translated(-backgroundRect.topLeft());
+    const auto size = blitFramebuffer->colorAttachment()->size();
+    if (size == backgroundRect.size()) {
+        return local;
+    }
+
+    const double scaleX = static_cast<double>(size.width()) / backgroundRect.width();
+    const double scaleY = static_cast<double>(size.height()) / backgroundRect.height();
+    const int left = static_cast<int>(std::floor(local.x() * scaleX));
+    const int top = static_cast<int>(std::floor(local.y() * scaleY));
+    const int right = static_cast<int>(std::ceil((local.x() + local.width()) * scaleX));
+    const int bottom = static_cast<int>(std::ceil((local.y() + local.height()) * scaleY));
+    return KWin::Rect{left, top, std::max(1, right - left), std::max(1, bottom - top)};
+}
 
 /**
  * Update the cached blit texture in blitFramebuffer
@@ -49,7 +112,7 @@ static inline void updateBlitFramebufferFromRenderTarget(const KWin::RenderTarge
         blitFramebuffer->blitFromRenderTarget(renderTarget,
                                               viewport,
                                               rect,
-                                              rect.translated(-backgroundRect.topLeft()));
+                                              blitDestination(rect, blitFramebuffer, backgroundRect));
     }
 }
 
@@ -63,16 +126,24 @@ static inline void updateBlitFramebufferFromWallpaper(BBDX::WallpaperData *wallp
                                                       const KWin::Rect &backgroundRect) {
     KWin::GLFramebuffer::pushFramebuffer(wallpaper->framebuffer.get());
     for (const auto &rect : dirtyRegion.rects()) {
-        blitFramebuffer->blitFromFramebuffer(rect.translated(-wallpaper->geometry.topLeft().toPoint()),
-                                             rect.translated(-backgroundRect.topLeft()));
+        // wallpaper may be down-scaled under memory pressure
+        const auto local = rect.translated(-wallpaper->geometry.topLeft().toPoint());
+        const KWin::Rect source{static_cast<int>(std::floor(local.x() * wallpaper->scale)),
+                                static_cast<int>(std::floor(local.y() * wallpaper->scale)),
+                                std::max(1, static_cast<int>(std::ceil(local.width() * wallpaper->scale))),
+                                std::max(1, static_cast<int>(std::ceil(local.height() * wallpaper->scale)))};
+        blitFramebuffer->blitFromFramebuffer(source,
+                                             blitDestination(rect, blitFramebuffer, backgroundRect));
     }
     KWin::GLFramebuffer::popFramebuffer();
 }
 
 std::unique_ptr<BBDX::BlurCacheEntry> BBDX::BlurCacheEntry::create(const KWin::Rect &backgroundRect,
                                                                    GLenum internalFormat,
-                                                                   const KWin::EffectWindow *window) {
+                                                                   const KWin::EffectWindow *window,
+                                                                   qreal scale) {
     std::unique_ptr<BlurCacheEntry> entry{new BlurCacheEntry()};
+    entry->m_scale = scale;
 
     if (window) {
         entry->m_windowClass = window->windowClass();
@@ -82,11 +153,16 @@ std::unique_ptr<BBDX::BlurCacheEntry> BBDX::BlurCacheEntry::create(const KWin::R
     qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX
                         << "Creating BlurCacheEntry:" << entry->m_windowClass << "\n"
                         << "PID:" << entry->m_windowPID << "\n"
-                        << "Size:" << backgroundRect;
+                        << "Size:" << backgroundRect << "\n"
+                        << "Scale:" << scale;
 
     // allocate new cached texture + framebuffer for the blurred texture
+    // all draws into it map to the full texture so a smaller scale
+    // only affects sampling resolution
+    const QSize textureSize{std::max(1, qRound(backgroundRect.width() * scale)),
+                            std::max(1, qRound(backgroundRect.height() * scale))};
     glClearColor(0.0, 0.0, 0.0, 0.0);
-    entry->m_cachedTexture = KWin::GLTexture::allocate(internalFormat, backgroundRect.size());
+    entry->m_cachedTexture = KWin::GLTexture::allocate(internalFormat, textureSize);
     if (!entry->m_cachedTexture) {
         qCWarning(BLUR_CACHE) << BBDX::LOG_PREFIX << "Failed to allocate an offscreen texture";
         return nullptr;
@@ -106,23 +182,252 @@ std::unique_ptr<BBDX::BlurCacheEntry> BBDX::BlurCacheEntry::create(const KWin::R
     return entry;
 }
 
+bool BBDX::BlurCacheEntry::matches(const KWin::Rect &backgroundRect, GLenum internalFormat) const {
+    const QSize textureSize{std::max(1, qRound(backgroundRect.width() * m_scale)),
+                            std::max(1, qRound(backgroundRect.height() * m_scale))};
+    return m_cachedTexture
+           && m_cachedTexture->size() == textureSize
+           && m_cachedTexture->internalFormat() == internalFormat;
+}
+
 bool BBDX::BlurCacheEntry::hasCachedRegion(const KWin::Region &dirtyRegion) const {
+    return m_tiles.covers(dirtyRegion.translated(-m_backgroundRect.topLeft()));
+}
+
+void BBDX::BlurCacheEntry::accumulateDirtyRegion(const KWin::Region &dirtyRegion) {
+    // tiles are clipped to backgroundRect
+    // so only dirtyRegion that has blur is tracked
+    m_tiles.markDirty(dirtyRegion.translated(-m_backgroundRect.topLeft()));
+
+    if (flushInProgress()) {
+        m_lateDamage += dirtyRegion & m_backgroundRect;
+    }
+
+    // damage history for video detection
+    const auto now = std::chrono::steady_clock::now();
+    qreal damagedArea{0.0};
     for (const auto &rect : dirtyRegion.rects()) {
-        if (!m_cachedRegion.contains(rect.translated(-m_backgroundRect.topLeft()))) {
-            return false;
+        const auto clipped = rect.intersected(m_backgroundRect);
+        damagedArea += qreal(clipped.width()) * clipped.height();
+    }
+
+    if (damagedArea > 0.0) {
+        if (m_damageArea <= 0.0) {
+            m_firstDamage = now;
         }
+        m_damageArea += damagedArea;
+    }
+
+    const qreal area = qreal(m_backgroundRect.width()) * m_backgroundRect.height();
+    if (area > 0.0 && damagedArea >= area * s_videoDamageCoverage) {
+        m_heavyDamage.push_back(now);
+    }
+
+    while (!m_heavyDamage.empty() && now - m_heavyDamage.front() > s_videoDamageWindow) {
+        m_heavyDamage.pop_front();
+    }
+
+    const bool videoDamage = m_heavyDamage.size() >= s_videoDamageFrames
+                             || (m_videoDamage && hasVideoDamage());
+    if (videoDamage != m_videoDamage) {
+        m_videoDamage = videoDamage;
+        qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX
+                            << "Video-like damage changed:" << m_windowClass << "\n"
+                            << "PID:" << m_windowPID << "\n"
+                            << "Active:" << m_videoDamage;
+    }
+}
+
+bool BBDX::BlurCacheEntry::hasVideoDamage() const {
+    return m_videoDamage
+           && !m_heavyDamage.empty()
+           && std::chrono::steady_clock::now() - m_heavyDamage.back() < s_videoDamageCooldown;
+}
+
+bool BBDX::BlurCacheEntry::hasSignificantDamage(qreal kernelArea, std::chrono::milliseconds maxStaleness) const {
+    if (m_damageArea <= 0.0) {
+        return false;
+    }
+
+    if (maxStaleness.count() <= 0 || kernelArea <= 0.0) {
+        return true;
     }
 
+    // a fully changed patch of damageArea pixels shifts a blurred pixel
+    // by at most damageArea / kernelArea of the full contrast
+    // below one 8 bit step nobody can tell the difference
+    if (m_damageArea >= kernelArea * s_significantDamage) {
+        return true;
+    }
+
+    return std::chrono::steady_clock::now() - m_firstDamage >= maxStaleness;
+}
+
+KWin::Region BBDX::BlurCacheEntry::accumulatedDirtyRegion() const {
+    return m_tiles.dirtyRegion().translated(m_backgroundRect.topLeft());
+}
+
+KWin::Region BBDX::BlurCacheEntry::flushRegion(int halo) const {
+    return m_tiles.dirtyRegionWithHalo(halo).translated(m_backgroundRect.topLeft());
+}
+
+KWin::Region BBDX::BlurCacheEntry::invalidRegion(int halo) const {
+    return m_tiles.invalidRegionWithHalo(halo).translated(m_backgroundRect.topLeft());
+}
+
+bool BBDX::BlurCacheEntry::translate(const KWin::Rect &rect, int halo) {
+    if (rect.size() != m_backgroundRect.size() || rect.topLeft() == m_backgroundRect.topLeft()) {
+        return false;
+    }
+
+    // content at a global position stays where it is
+    // so in local coordinates it moves the opposite way
+    const QPoint offset = m_backgroundRect.topLeft() - rect.topLeft();
+    const KWin::Rect bounds{0, 0, rect.width(), rect.height()};
+    const KWin::Rect destination = bounds.intersected(bounds.translated(offset));
+
+    // the pyramid of a progressive flush shows the old position
+    resetProgress();
+
+    if (destination.isEmpty()) {
+        m_tiles.invalidate();
+        m_backgroundRect = rect;
+        return false;
+    }
+
+    // the scratch buffer is about to be overwritten
+    finishAsyncFlush();
+
+    if (!ensureScratchBuffer()) {
+        m_tiles.invalidate();
+        m_backgroundRect = rect;
+        return false;
+    }
+
+    // the texture may be down-scaled under memory pressure
+    const auto toTexture = [this](const KWin::Rect &local) {
+        return KWin::Rect{qRound(local.x() * m_scale),
+                          qRound(local.y() * m_scale),
+                          std::max(1, qRound(local.width() * m_scale)),
+                          std::max(1, qRound(local.height() * m_scale))};
+    };
+
+    // overlapping blits within one framebuffer are undefined,
+    // go through the scratch texture and swap
+    KWin::GLFramebuffer::pushFramebuffer(m_cachedFramebuffer.get());
+    m_scratchFramebuffer->blitFromFramebuffer(toTexture(destination.translated(-offset)), toTexture(destination));
+    KWin::GLFramebuffer::popFramebuffer();
+
+    swapBuffers();
+
+    m_tiles.translate(offset, halo);
+    m_backgroundRect = rect;
     return true;
 }
 
-void BBDX::BlurCacheEntry::accumulateDirtyRegion(const KWin::Region &dirtyRegion) {
-    for (const auto &rect : dirtyRegion.rects()) {
-        m_accumulatedDirtyRegion |= rect;
+bool BBDX::BlurCacheEntry::ensureScratchBuffer() {
+    if (m_scratchTexture) {
+        return true;
+    }
+
+    m_scratchTexture = KWin::GLTexture::allocate(m_cachedTexture->internalFormat(), m_cachedTexture->size());
+    if (!m_scratchTexture) {
+        qCWarning(BLUR_CACHE) << BBDX::LOG_PREFIX << "Failed to allocate a scratch texture";
+        return false;
+    }
+    m_scratchTexture->setFilter(GL_LINEAR);
+    m_scratchTexture->setWrapMode(GL_CLAMP_TO_EDGE);
+    m_scratchFramebuffer = std::make_unique<KWin::GLFramebuffer>(m_scratchTexture.get());
+    if (!m_scratchFramebuffer->valid()) {
+        qCWarning(BLUR_CACHE) << BBDX::LOG_PREFIX << "Failed to create a scratch framebuffer";
+        m_scratchFramebuffer.reset();
+        m_scratchTexture.reset();
+        return false;
+    }
+    return true;
+}
+
+void BBDX::BlurCacheEntry::releaseScratchBuffer() {
+    if (!m_scratchTexture || m_asyncFlushing || m_swapFence) {
+        return;
+    }
+
+    m_scratchFramebuffer.reset();
+    m_scratchTexture.reset();
+}
+
+void BBDX::BlurCacheEntry::swapBuffers() {
+    std::swap(m_cachedTexture, m_scratchTexture);
+    std::swap(m_cachedFramebuffer, m_scratchFramebuffer);
+}
+
+BBDX::BlurCacheEntry::~BlurCacheEntry() {
+    if (m_swapFence) {
+        glDeleteSync(m_swapFence);
+    }
+}
+
+bool BBDX::BlurCacheEntry::beginAsyncFlush() {
+    // a newer flush replaces the pending one
+    finishAsyncFlush();
+
+    if (!ensureScratchBuffer()) {
+        return false;
+    }
+
+    // the flush only re-blurs part of the cache,
+    // the back buffer starts out as a copy of the rest
+    const KWin::Rect bounds{0, 0, m_cachedTexture->width(), m_cachedTexture->height()};
+    KWin::GLFramebuffer::pushFramebuffer(m_cachedFramebuffer.get());
+    m_scratchFramebuffer->blitFromFramebuffer(bounds, bounds);
+    KWin::GLFramebuffer::popFramebuffer();
+
+    m_asyncFlushing = true;
+    return true;
+}
+
+void BBDX::BlurCacheEntry::endAsyncFlush() {
+    if (!m_asyncFlushing) {
+        return;
     }
 
-    // we only care about dirtyRegion that has blur
-    m_accumulatedDirtyRegion &= m_backgroundRect;
+    m_asyncFlushing = false;
+    m_swapFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // no fence, no way to tell when it's done
+    if (!m_swapFence) {
+        swapBuffers();
+    }
+}
+
+bool BBDX::BlurCacheEntry::swapIfReady() {
+    if (!m_swapFence) {
+        return false;
+    }
+
+    // GL_TIMEOUT_EXPIRED: still rendering, check again next frame
+    const GLenum status = glClientWaitSync(m_swapFence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+
+    finishAsyncFlush();
+    return true;
+}
+
+void BBDX::BlurCacheEntry::finishAsyncFlush() {
+    if (!m_swapFence) {
+        return;
+    }
+
+    glDeleteSync(m_swapFence);
+    m_swapFence = nullptr;
+    swapBuffers();
+}
+
+void BBDX::BlurCacheEntry::setBackgroundRect(const KWin::Rect &rect) {
+    m_backgroundRect = rect;
+    m_tiles.resize(rect.size());
 }
 
 void BBDX::BlurCacheEntry::flush(const char *msg) {
@@ -139,10 +444,24 @@ void BBDX::BlurCacheEntry::flush(const char *msg) {
 }
 
 
+void BBDX::BlurCacheEntry::requestFlush(const char *msg) {
+    if (m_isFlushing || m_flushRequested) return;
+
+    m_flushRequested = true;
+
+    if (msg) {
+        qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX
+                            << "Requested flush:" << m_windowClass << "\n"
+                            << "PID:" << m_windowPID << "\n"
+                            << "Reason:" << msg;
+    }
+}
+
 void BBDX::BlurCacheEntry::abortFlush(const char *msg) {
     if (!m_isFlushing) return;
 
     m_isFlushing = false;
+    resetProgress();
 
     if (msg) {
         qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX
@@ -153,17 +472,50 @@ void BBDX::BlurCacheEntry::abortFlush(const char *msg) {
 }
 
 void BBDX::BlurCacheEntry::flushed(const BlurCachePaintData &paintData) {
-    if (m_isFlushing) {
-        for (const auto &rect : paintData.cacheShape) {
-            m_cachedRegion |= rect;
+    if (m_isFlushing && !flushInProgress()) {
+        // what the flush rendered, not just what was damaged this frame
+        // skipped pixels are never seen, so they don't keep the tiles
+        // along the edge of the window's opaque content from turning valid
+        const KWin::Region flushedRegion = (paintData.flushRegion | *paintData.skipRegion) & m_backgroundRect;
+        m_tiles.markFlushed(flushedRegion.translated(-m_backgroundRect.topLeft()));
+        m_lastFlush = std::chrono::steady_clock::now();
+
+        // damage that came in while a progressive flush ran isn't part of it
+        if (!m_lateDamage.isEmpty()) {
+            m_tiles.markDirty(m_lateDamage.translated(-m_backgroundRect.topLeft()));
+            m_lateDamage = KWin::Region();
         }
 
-        m_accumulatedDirtyRegion = KWin::Region{};
-        m_lastFlush = std::chrono::steady_clock::now();
+        // partial flushes keep counting towards the rest
+        if (!m_tiles.isDirty()) {
+            m_damageArea = 0.0;
+        }
         m_isFlushing = false;
+        m_flushRequested = false;
     }
 }
 
+std::pair<size_t, size_t> BBDX::BlurCacheEntry::advanceFlush(size_t passesPerFrame, size_t totalPasses) {
+    // all at once always starts from scratch
+    const size_t first = passesPerFrame == 0 ? 0 : m_flushPass;
+    const size_t end = passesPerFrame == 0 ? totalPasses : std::min(totalPasses, first + passesPerFrame);
+
+    // done once the last pass ran
+    m_flushPass = end < totalPasses ? end : 0;
+
+    return {first, end};
+}
+
+void BBDX::BlurCacheEntry::startProgress(const KWin::Region &flushRegion) {
+    m_progressRegion = flushRegion;
+    m_lateDamage = KWin::Region();
+}
+
+void BBDX::BlurCacheEntry::resetProgress() {
+    m_flushPass = 0;
+    m_lateDamage = KWin::Region();
+}
+
 void BBDX::BlurCacheEntry::flushFor(std::chrono::milliseconds duration, const char *msg) {
     flush(msg);
     m_flushingUntil = std::chrono::steady_clock::now() + duration;
@@ -175,6 +527,40 @@ void BBDX::BlurCacheEntry::maybeExtendFlush() {
     }
 }
 
+void BBDX::BlurCacheEntry::beginFlushTiming() {
+    if (!m_flushTimer) {
+        m_flushTimer = GPUTimer::create();
+    }
+
+    if (m_flushTimer) {
+        m_flushTimer->begin();
+    }
+}
+
+void BBDX::BlurCacheEntry::endFlushTiming() {
+    if (m_flushTimer) {
+        m_flushTimer->end();
+    }
+}
+
+std::optional<std::chrono::microseconds> BBDX::BlurCacheEntry::updateFlushCost() {
+    if (!m_flushTimer) {
+        return std::nullopt;
+    }
+
+    const auto sample = m_flushTimer->poll();
+    if (!sample) {
+        return std::nullopt;
+    }
+
+    if (m_flushCost.count() == 0) {
+        m_flushCost = *sample;
+    } else {
+        m_flushCost += (*sample - m_flushCost) / 4;
+    }
+    return sample;
+}
+
 void BBDX::BlurCacheEntry::invalidate(uint flags, const char* msg) {
     QStringList flagsHandled{};
 
@@ -186,10 +572,10 @@ void BBDX::BlurCacheEntry::invalidate(uint flags, const char* msg) {
     }
 
     if (flags & static_cast<uint>(BlurCacheInvalidationFlag::REGION)) {
-        if (!m_cachedRegion.isEmpty()) {
-            m_cachedRegion = KWin::Region{};
-            flagsHandled += "REGION";
-        }
+        m_tiles.invalidate();
+        // e.g. the pyramid was re-allocated, start over
+        resetProgress();
+        flagsHandled += "REGION";
     }
 
     if (msg && !flagsHandled.empty()) {
@@ -201,12 +587,21 @@ void BBDX::BlurCacheEntry::invalidate(uint flags, const char* msg) {
     }
 }
 
+void BBDX::BlurCacheEntry::rebind(const KWin::EffectWindow *window) {
+    if (!window) {
+        return;
+    }
+
+    m_windowClass = window->windowClass();
+    m_windowPID = window->pid();
+}
+
 void BBDX::BlurCache::slotWallpaperDamaged(KWin::Window *window) {
     Q_UNUSED(window);
 
     for (auto &[view, wallpaper] : m_wallpapers) {
-        if (window == wallpaper.window) {
-            wallpaper.damaged = true;
+        if (window == wallpaper->window) {
+            wallpaper->damaged = true;
         }
     }
 
@@ -219,6 +614,12 @@ std::unique_ptr<BBDX::BlurCache> BBDX::BlurCache::create(BBDX::BlurEffect *effec
 
     blurCache->m_effect = effect;
 
+    blurCache->m_videoDamageTimer.setSingleShot(true);
+    blurCache->m_videoDamageTimer.setInterval(s_videoDamageCooldown);
+    connect(&blurCache->m_videoDamageTimer, &QTimer::timeout, blurCache.get(), [effect]() {
+        effect->windowManager()->repaintAllBlurredWindows();
+    });
+
     blurCache->m_texturePass.shader = KWin::ShaderManager::instance()->generateShaderFromFile(
         KWin::ShaderTrait::MapTexture,
         BBDX::shaderFilePath(":/effects/better_blur_dx/shaders/vertex.vert"),
@@ -241,10 +642,17 @@ void BBDX::BlurCache::reconfigure() {
     m_blitMode = BlitMode::RENDER_TARGET;
 #else
     m_blitMode = static_cast<BlitMode>(BlurConfig::blitMode());
+
+    // wallpaper mode barely ever needs to flush
+    if (m_effect->powerSaving()) {
+        m_blitMode = BlitMode::WALLPAPER;
+    }
 #endif
 
     m_ignoreCache = BlurConfig::blurCacheIgnore();
     m_cacheRateLimit = std::chrono::milliseconds{BlurConfig::blurCacheRateLimit()};
+    m_cacheFrameBudget = std::chrono::microseconds{BlurConfig::blurCacheFrameBudget()};
+    m_maxStaleness = std::chrono::milliseconds{BlurConfig::blurCacheMaxStaleness()};
 
     switch (m_blitMode) {
         case BlitMode::WALLPAPER:
@@ -263,6 +671,8 @@ void BBDX::BlurCache::reconfigure() {
             break;
     }
 
+    // without the cache every frame flushes anyways
+    m_progressivePasses = m_ignoreCache ? 0 : static_cast<size_t>(std::max(0, BlurConfig::blurCacheProgressivePasses()));
 }
 
 void BBDX::BlurCache::preparePaintData(const KWin::RenderTarget *renderTarget,
@@ -273,16 +683,8 @@ void BBDX::BlurCache::preparePaintData(const KWin::RenderTarget *renderTarget,
                                        KWin::GLFramebuffer *blitFramebuffer,
                                        const KWin::Rect *backgroundRect,
                                        const KWin::Rect *scaledBackgroundRect,
-                                       std::unique_ptr<BlurCacheEntry> &cache) {
-    
-    QList<KWin::Rect> cacheShape{};
-    for (const auto &rect : dirtyRegion->rects()) {
-        auto clippedLocalRect = rect.intersected(*backgroundRect)
-                                    .translated(-backgroundRect->topLeft());
-        if (!clippedLocalRect.isEmpty()) {
-            cacheShape.append(std::move(clippedLocalRect));
-        }
-    }
+                                       const KWin::Region *skipRegion,
+                                       std::shared_ptr<BlurCacheEntry> &cache) {
 
     m_paintData = {
         .renderTarget = renderTarget,
@@ -293,14 +695,44 @@ void BBDX::BlurCache::preparePaintData(const KWin::RenderTarget *renderTarget,
         .backgroundRect = backgroundRect,
         .scaledBackgroundRect = scaledBackgroundRect,
         .blitFramebuffer = blitFramebuffer,
-        .cacheShape = std::move(cacheShape),
+        .skipRegion = skipRegion,
+        .flushRegion = *dirtyRegion,
+    };
+
+    const BlurCacheKey key{
+        .viewGeometry = viewport->renderRect(),
+        .viewScale = viewport->scale(),
+        .blitMode = m_blitMode,
     };
 
-    // create new cache entry if needed
+    // views stop sharing an entry once they show different content
+    if (cache && cache.use_count() > 1 && cache->key() != key) {
+        cache.reset();
+    }
+
+    // entries with an outdated scale are replaced
+    // e.g. once memory pressure changed
+    if (cache && cache->valid() && !qFuzzyCompare(cache->scale(), cacheScale())) {
+        cache->invalidate(static_cast<uint>(BlurCacheInvalidationFlag::FULL), "Memory pressure changed");
+    }
+
+    // the entry outlives pyramid reallocations (e.g. dynamic resolution scaling)
+    // so it's only replaced when its own texture doesn't fit anymore
+    if (cache && cache->valid() && !cache->matches(*backgroundRect, blitFramebuffer->colorAttachment()->internalFormat())) {
+        cache->invalidate(static_cast<uint>(BlurCacheInvalidationFlag::FULL), "Size or format changed");
+    }
+
+    // share or create new cache entry if needed
     if (!cache || !cache->valid()) {
+        const GLenum internalFormat = m_paintData.blitFramebuffer->colorAttachment()->internalFormat();
+        cache = findSharedEntry(window, view, key, *backgroundRect, internalFormat);
+    }
+
+    if (!cache) {
         cache = BBDX::BlurCacheEntry::create(*m_paintData.backgroundRect,
                                              m_paintData.blitFramebuffer->colorAttachment()->internalFormat(),
-                                             m_paintData.window);
+                                             m_paintData.window,
+                                             cacheScale());
         // XXX: ensure this is safe
         // and BlurEffect::blur() bails
         // if this fails or we get nullptr derefs when trying to
@@ -314,9 +746,34 @@ void BBDX::BlurCache::preparePaintData(const KWin::RenderTarget *renderTarget,
         cache->flush("Fresh cache entry");
     }
 
+    cache->setKey(key);
+
     // the cache entry needs to stay in sync
+    // on a pure move (e.g. window drags) its content is reused
+    const bool moved = cache->translate(*backgroundRect, m_effect->expandSize());
     cache->setBackgroundRect(*backgroundRect);
-    cache->accumulateDirtyRegion(*dirtyRegion);
+
+    // the scratch buffer is as large as the cache itself, only keep it
+    // while the window is being moved or may flush asynchronously
+    // (which memory pressure rules out, see asyncFlushAllowed())
+    const bool asyncFlush = m_memoryPressure == MemoryPressureMonitor::Level::None
+                            && m_effect->windowManager()->windowBlurProfile(window, view).asyncFlush;
+    if (!moved && !asyncFlush) {
+        cache->releaseScratchBuffer();
+    }
+
+    // repaints only showing the unchanged blur
+    // of windows below don't outdate this one
+    if (m_blitMode == BlitMode::WALLPAPER) {
+        cache->accumulateDirtyRegion(*dirtyRegion);
+    } else {
+        cache->accumulateDirtyRegion(*dirtyRegion - m_effect->m_blurDependencies.stableRegion(view, window));
+    }
+
+    // (re-)arm the repaint for when the damage stops
+    if (cache->hasVideoDamage()) {
+        m_videoDamageTimer.start();
+    }
 
     // always flush if the user says that's what they want
     if (m_ignoreCache) {
@@ -328,18 +785,65 @@ void BBDX::BlurCache::preparePaintData(const KWin::RenderTarget *renderTarget,
     // in case the initial cache entry
     // was only partially filled we always need a flush
     // to not draw uncached regions
+    const bool partialFlush = !cache->isFlushing() && !cache->hasCachedRegion(*dirtyRegion);
     if (!cache->hasCachedRegion(*dirtyRegion)) {
         cache->flush("Incomplete cached region");
     }
 
+    // a progressive flush shows the cached blur until it's done
+    // so the entry needs complete content (not fresh, invalidated or
+    // partially filled) and entries shared between views can't run
+    // one since each view renders into its own pyramid
+    const bool progressive = cache.use_count() == 1
+                             && cache->hasCachedRegion(KWin::Region(*backgroundRect) - *skipRegion);
+    m_paintData.progressivePasses = progressive ? m_progressivePasses : 0;
+
+    // progress made with another view's pyramid or over
+    // content that got lost is of no use, start over in one go
+    if (cache->flushInProgress() && m_paintData.progressivePasses == 0) {
+        cache->resetProgress();
+    }
+
+    // windows entering on a desktop switch show what they have cached
+    // until it's their turn in the pre-warm queue, forcing all of their
+    // re-flushes into the first frame of the slide is what the queue avoids
+    // (entries without complete content have nothing to show meanwhile)
+    if (!m_ignoreCache
+        && m_effect->windowManager()->windowIsPrewarmPending(window)
+        && cache->hasCachedRegion(KWin::Region(*backgroundRect) - *skipRegion)) {
+        cache->abortFlush("Waiting for desktop switch pre-warm");
+    }
+
     // dirtyRegion can end up empty in some rare cases
     // in that case there is nothing to do
-    if (dirtyRegion->isEmpty()) {
+    // (unless a progressive flush is half way done)
+    if (dirtyRegion->isEmpty() && !cache->flushInProgress()) {
         cache->abortFlush("Empty dirtyRegion");
     }
 
     // when flushing we need the updated blit
     if (cache->isFlushing()) {
+        // a progressive flush keeps re-blurring what it started with,
+        // the first downsample pass already consumed its blit
+        if (cache->flushInProgress()) {
+            m_paintData.flushRegion = cache->progressRegion();
+            return;
+        }
+
+        // re-blur everything the dirty tiles can affect
+        m_paintData.flushRegion = (*dirtyRegion | cache->flushRegion(m_effect->expandSize())) & *backgroundRect;
+
+        // the wallpaper didn't change just because something was painted,
+        // only fill in what's missing e.g. after a move
+        if (m_blitMode == BlitMode::WALLPAPER && partialFlush) {
+            m_paintData.flushRegion = cache->invalidRegion(m_effect->expandSize()) & *backgroundRect;
+        }
+
+        // nothing under opaque content needs re-blurring
+        m_paintData.flushRegion -= *skipRegion;
+
+        cache->startProgress(m_paintData.flushRegion);
+
         if (m_blitMode == BlitMode::WALLPAPER) {
             auto wallpaper = getWallpaper();
             if (!wallpaper) {
@@ -413,61 +917,302 @@ void BBDX::BlurCache::drawCached(const KWin::RenderViewport &viewport, BBDX::Blu
 }
 
 void BBDX::BlurCache::drawToCache(BBDX::BlurCacheEntry *cache, KWin::GLVertexBuffer *vbo) const {
-    auto cachedFramebuffer = cache->cachedFramebuffer();
+    auto cachedFramebuffer = cache->flushFramebuffer();
     KWin::GLFramebuffer::pushFramebuffer(cachedFramebuffer);
-    BBDX::setGLScissor(*m_paintData.dirtyRegion, *m_paintData.backgroundRect);
-    vbo->draw(GL_TRIANGLES, vboStartCache(), vboCountCache());
+    BBDX::drawGLScissored(m_paintData.flushRegion, *m_paintData.backgroundRect, [this, vbo]() {
+        vbo->draw(GL_TRIANGLES, vboStartCache(), vboCountCache());
+    });
     KWin::GLFramebuffer::popFramebuffer();
 }
 
 
-void BBDX::BlurCache::flushAccumulatedDirtyRegions(KWin::ScreenPrePaintData &data) const {
+bool BBDX::BlurCache::asyncFlushAllowed(const BBDX::BlurCacheEntry *cache) const {
+    return m_memoryPressure == MemoryPressureMonitor::Level::None
+           && !m_ignoreCache
+           && cache->hasCachedRegion(*m_paintData.dirtyRegion);
+}
+
+void BBDX::BlurCache::scheduleFlushIntervals(const KWin::RenderView *view) const {
+    std::vector<BlurCacheEntry *> entries{};
+    std::chrono::microseconds gpuTime{0};
     for (auto &[window, effectData] : m_effect->m_windows) {
-        for (auto &[view, renderData] : effectData.render) {
-#if defined(BBDX_X11)
-            if (view != data.screen) {
-                continue;
+        if (auto it = effectData.render.find(const_cast<KWin::RenderView *>(view)); it != effectData.render.end() && it->second.cache) {
+            if (const auto sample = it->second.cache->updateFlushCost()) {
+                gpuTime += *sample;
             }
+            entries.push_back(it->second.cache.get());
+        }
+    }
+
+    // the same measurements tell dynamic resolution about the GPU load
+    m_effect->m_dynamicResolution.addGPUTime(view, gpuTime);
+
+    if (m_cacheFrameBudget.count() <= 0) {
+        for (auto entry : entries) {
+            entry->setFlushInterval(std::nullopt);
+        }
+        return;
+    }
+
+    const auto refreshInterval = m_effect->outputRefresh().refreshInterval(view);
+
+    // water-filling: cheapest entries first, each gets an equal share
+    // of what's left and backs off by as many frames as it exceeds that share
+    std::ranges::sort(entries, [](const BlurCacheEntry *a, const BlurCacheEntry *b) {
+        return a->flushCost() < b->flushCost();
+    });
+
+    double remaining = static_cast<double>(m_cacheFrameBudget.count());
+    size_t left = entries.size();
+    for (auto entry : entries) {
+        const double share = std::max(remaining / left--, 1.0);
+        const double cost = static_cast<double>(entry->flushCost().count());
+
+        // not measured yet, stick to the fixed rate limit
+        if (cost <= 0.0) {
+            entry->setFlushInterval(std::nullopt);
+            continue;
+        }
+
+        const double frames = std::max(1.0, std::ceil(cost / share));
+        remaining = std::max(0.0, remaining - cost / frames);
+
+        entry->setFlushInterval(std::min(std::chrono::duration_cast<std::chrono::microseconds>(refreshInterval * frames),
+                                         s_maxFlushInterval));
+    }
+}
+
+void BBDX::BlurCache::flushAccumulatedDirtyRegions(KWin::ScreenPrePaintData &data) const {
+#if defined(BBDX_X11)
+    const KWin::RenderView *currentView = data.screen;
 #else
-            if (view != data.view) {
-                continue;
-            }
+    const KWin::RenderView *currentView = data.view;
 #endif
 
-            auto cacheEntry = renderData.cache.get();
-            if (!cacheEntry) {
-                continue;
+    scheduleFlushIntervals(currentView);
+
+    // every n-th frame of this view or the fixed rate limit
+    const std::chrono::microseconds viewRateLimit = m_effect->outputRefresh().rateLimit(currentView).value_or(m_cacheRateLimit);
+
+    // forced flushes (fresh entries, flushFor(), ...) always happen
+    // everything else competes for the remaining budget of this frame
+    std::vector<FlushCandidate> candidates{};
+    std::chrono::microseconds budget = flushBudget(currentView);
+
+    for (auto &[window, effectData] : m_effect->m_windows) {
+        auto it = effectData.render.find(const_cast<KWin::RenderView *>(currentView));
+        if (it == effectData.render.end()) {
+            continue;
+        }
+
+        auto cacheEntry = it->second.cache.get();
+        if (!cacheEntry) {
+            continue;
+        }
+
+        // show finished asynchronous flushes, keep polling the rest
+        if (cacheEntry->swapPending()) {
+            if (cacheEntry->swapIfReady()) {
+                data.paint |= cacheEntry->backgroundRect();
+            } else {
+                effects->addRepaint(cacheEntry->backgroundRect());
             }
+        }
+
+        // nobody sees it, it's re-blurred once exposed again
+        if (m_effect->windowManager()->windowIsBlurFullyCovered(window)) {
+            continue;
+        }
 
-            // automatic periodic flush
-            // external flushes are picked up either way
-            switch (m_blitMode) {
-                case BlitMode::WALLPAPER:
-                    // never flush automatically in wallpaper mode
+        if (cacheEntry->isFlushing()) {
+            budget -= estimatedFlushCost(cacheEntry);
+            continue;
+        }
+
+        // external flushes are deferrable
+        bool wantsFlush{cacheEntry->flushRequested()};
+
+        // automatic periodic flush
+        switch (m_blitMode) {
+            case BlitMode::WALLPAPER:
+                // never flush automatically in wallpaper mode
+                break;
+
+            default:
+                // windows entering on a desktop switch
+                // wait for their turn in the pre-warm queue
+                if (m_effect->windowManager()->windowIsPrewarmPending(window)) {
+                    break;
+                }
+
+                const BlurProfile profile = m_effect->windowManager()->windowBlurProfile(window, currentView);
+                if (profile.isStatic) {
                     break;
+                }
+
+                // configurable flush in normal mode
+                // the window's profile replaces the view's rate limit,
+                // a frame budget derived interval may only slow it down further
+                std::chrono::microseconds interval = cacheEntry->flushInterval().value_or(viewRateLimit);
+                if (profile.rateLimit) {
+                    interval = cacheEntry->flushInterval()
+                                   ? std::max<std::chrono::microseconds>(*cacheEntry->flushInterval(), *profile.rateLimit)
+                                   : std::chrono::microseconds{*profile.rateLimit};
+                }
 
-                default:
-                    // configurable flush in normal mode
-                    if (m_cacheRateLimit.count() <= 0) {
-                        // Unlimited
-                        cacheEntry->flush();
-                    } else {
-                        // Rate limited
-                        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - cacheEntry->lastFlush());
-
-                        if (elapsed > m_cacheRateLimit) {
-                            cacheEntry->flush();
-                        }
+                // small damage (carets, clocks, spinners) vanishes in a wide kernel,
+                // let it pile up until it can be seen or got too old
+                const qreal kernelRadius = m_effect->effectiveBlur(profile, currentView).kernelRadius();
+                if (!cacheEntry->hasSignificantDamage(4.0 * kernelRadius * kernelRadius, m_maxStaleness)) {
+                    break;
+                }
+
+                if (interval.count() <= 0) {
+                    // Unlimited
+                    wantsFlush = true;
+                } else {
+                    // Rate limited
+                    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - cacheEntry->lastFlush());
+
+                    if (elapsed > interval) {
+                        wantsFlush = true;
                     }
+                }
+        }
+
+        if (wantsFlush) {
+            candidates.push_back(FlushCandidate{
+                .entry = cacheEntry,
+                .visible = window->isOnCurrentDesktop()
+                           && !window->isMinimized()
+                           && !m_effect->windowManager()->windowIsBlurFullyCovered(window),
+            });
+        }
+    }
+
+    // visible first, then the ones waiting the longest
+    std::ranges::sort(candidates, [](const FlushCandidate &a, const FlushCandidate &b) {
+        if (a.visible != b.visible) {
+            return a.visible;
+        }
+        return a.entry->lastFlush() < b.entry->lastFlush();
+    });
+
+    // at least one deferrable flush per frame so nothing starves
+    bool first{true};
+    for (const auto &candidate : candidates) {
+        const auto cost = estimatedFlushCost(candidate.entry);
+        if (!first && cost > budget) {
+            continue;
+        }
+
+        candidate.entry->flush();
+        budget -= cost;
+        first = false;
+    }
+
+    // stacked blurred windows see each other's blur,
+    // in wallpaper mode they only see the wallpaper
+    if (m_blitMode != BlitMode::WALLPAPER) {
+        std::vector<BlurDependencyGraph::Node> nodes{};
+        for (const auto &window : effects->stackingOrder()) {
+            const auto effectIt = m_effect->m_windows.find(window);
+            if (effectIt == m_effect->m_windows.end()) {
+                continue;
             }
 
-            if (cacheEntry->isFlushing()) {
-                for (const auto &rect : cacheEntry->accumulatedDirtyRegion().rects()) {
-                    data.paint |= rect;
-                }
+            const auto it = effectIt->second.render.find(const_cast<KWin::RenderView *>(currentView));
+            if (it == effectIt->second.render.end() || !it->second.cache) {
+                continue;
+            }
+
+            if (m_effect->windowManager()->windowIsBlurFullyCovered(window)) {
+                continue;
             }
+
+            nodes.push_back(BlurDependencyGraph::Node{
+                .window = window,
+                .entry = it->second.cache.get(),
+                .backgroundRect = it->second.cache->backgroundRect(),
+                .flushing = it->second.cache->isFlushing(),
+            });
+        }
+
+        const KWin::Region dependentRegion = m_effect->m_blurDependencies.update(currentView, std::move(nodes), m_effect->expandSize());
+        for (const auto &rect : dependentRegion.rects()) {
+            data.paint |= rect;
+        }
+    }
+
+    for (auto &[window, effectData] : m_effect->m_windows) {
+        auto it = effectData.render.find(const_cast<KWin::RenderView *>(currentView));
+        if (it == effectData.render.end() || !it->second.cache) {
+            continue;
+        }
+
+        if (m_effect->windowManager()->windowIsBlurFullyCovered(window)) {
+            continue;
+        }
+
+        if (it->second.cache->isFlushing()) {
+            const KWin::Region accumulatedDirtyRegion = it->second.cache->accumulatedDirtyRegion();
+            for (const auto &rect : accumulatedDirtyRegion.rects()) {
+                data.paint |= rect;
+            }
+        }
+    }
+}
+
+std::chrono::microseconds BBDX::BlurCache::flushBudget(const KWin::RenderView *view) const {
+    if (m_cacheFrameBudget.count() > 0) {
+        return m_cacheFrameBudget;
+    }
+
+    // by default roughly one full screen of blur per frame
+#if defined(BBDX_X11)
+    const auto size = view->geometry().size();
+#else
+    const auto size = view->logicalOutput()->geometry().size();
+#endif
+    return std::chrono::microseconds{static_cast<int64_t>(size.width()) * size.height() * s_estimatedCostPerMegapixel.count() / 1'000'000};
+}
+
+std::chrono::microseconds BBDX::BlurCache::estimatedFlushCost(const BlurCacheEntry *entry) const {
+    if (entry->flushCost().count() > 0) {
+        return entry->flushCost();
+    }
+
+    const auto &rect = entry->backgroundRect();
+    return std::chrono::microseconds{static_cast<int64_t>(rect.width()) * rect.height() * s_estimatedCostPerMegapixel.count() / 1'000'000};
+}
+
+std::shared_ptr<BBDX::BlurCacheEntry> BBDX::BlurCache::findSharedEntry(const KWin::EffectWindow *window,
+                                                                      const KWin::RenderView *view,
+                                                                      const BlurCacheKey &key,
+                                                                      const KWin::Rect &backgroundRect,
+                                                                      GLenum internalFormat) const {
+    const auto it = m_effect->m_windows.find(const_cast<KWin::EffectWindow *>(window));
+    if (it == m_effect->m_windows.end()) {
+        return nullptr;
+    }
+
+    for (const auto &[otherView, renderData] : it->second.render) {
+        const auto &entry = renderData.cache;
+        if (otherView == view || !entry || !entry->valid()) {
+            continue;
+        }
+
+        if (entry->key() == key
+            && entry->matches(backgroundRect, internalFormat)
+            && qFuzzyCompare(entry->scale(), cacheScale())) {
+            qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX
+                                << "Sharing BlurCacheEntry:" << window->windowClass() << "\n"
+                                << "Views:" << entry.use_count() + 1;
+            return entry;
         }
     }
+
+    return nullptr;
 }
 
 BBDX::WallpaperData* BBDX::BlurCache::getWallpaper() {
@@ -502,13 +1247,36 @@ BBDX::WallpaperData* BBDX::BlurCache::getWallpaper() {
         textureFormat = renderTarget->texture()->internalFormat();
     }
 
-    const QSize textureSize{(view->logicalOutput()->geometryF().size()).toSize()};
+    const qreal scale{wallpaperScale()};
+    const QSize textureSize{(view->logicalOutput()->geometryF().size() * scale).toSize()};
 
     const RectF geometry{view->logicalOutput()->geometryF()};
 
 
     // cached wallpaper
-    WallpaperData &wallpaper = m_wallpapers[view];
+    // views showing the same part of the scene (e.g. mirrored outputs)
+    // share one copy as long as it fits all of them
+    auto sharesWallpaper = [&](const WallpaperData &other) {
+        return other.texture
+               && other.texture->internalFormat() == textureFormat
+               && qFuzzyCompare(other.scale, scale)
+               && other.geometry == geometry;
+    };
+
+    std::shared_ptr<WallpaperData> &slot = m_wallpapers[view];
+    if (!slot || (slot.use_count() > 1 && !sharesWallpaper(*slot))) {
+        slot.reset();
+        for (const auto &[otherView, other] : m_wallpapers) {
+            if (other && otherView != view && sharesWallpaper(*other)) {
+                slot = other;
+                break;
+            }
+        }
+        if (!slot) {
+            slot = std::make_shared<WallpaperData>();
+        }
+    }
+    WallpaperData &wallpaper = *slot;
 
     bool textureValid = wallpaper.texture
                         && wallpaper.texture->internalFormat() == textureFormat
@@ -516,6 +1284,7 @@ BBDX::WallpaperData* BBDX::BlurCache::getWallpaper() {
 
     // wallpaper (still) valid
     if (textureValid
+        && qFuzzyCompare(wallpaper.scale, scale)
         && wallpaper.geometry == geometry
         && wallpaper.window == desktop->window()
         && !wallpaper.damaged) {
@@ -523,6 +1292,7 @@ BBDX::WallpaperData* BBDX::BlurCache::getWallpaper() {
     }
 
     wallpaper.geometry = geometry;
+    wallpaper.scale = scale;
 
     if (!textureValid) {
         // realloc framebuffer+texture when needed
@@ -545,7 +1315,7 @@ BBDX::WallpaperData* BBDX::BlurCache::getWallpaper() {
     }
 
     const RenderTarget wallpaperRenderTarget{wallpaper.framebuffer.get(), renderTarget->colorDescription()};
-    const RenderViewport wallpaperRenderViewport{wallpaper.geometry, 1.0, wallpaperRenderTarget, QPoint{}};
+    const RenderViewport wallpaperRenderViewport{wallpaper.geometry, wallpaper.scale, wallpaperRenderTarget, QPoint{}};
     WindowPaintData data{};
 
     GLFramebuffer::pushFramebuffer(wallpaper.framebuffer.get());
@@ -570,8 +1340,10 @@ void BBDX::BlurCache::dropWallpaper(KWin::RenderView *view) {
         return;
     }
 
-    // cleanup
-    disconnect(it->second.connection);
+    // cleanup, other views may still use it
+    if (it->second.use_count() == 1) {
+        disconnect(it->second->connection);
+    }
 
     qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX << "Dropping wallpaper buffer";
 
@@ -579,3 +1351,150 @@ void BBDX::BlurCache::dropWallpaper(KWin::RenderView *view) {
 
     m_wallpapers.erase(it);
 }
+
+bool BBDX::BlurCache::isTombstoneCandidate(const KWin::EffectWindow *w) {
+    return w->isMenu()
+           || w->isDropdownMenu()
+           || w->isPopupMenu()
+           || w->isPopupWindow()
+           || w->isTooltip();
+}
+
+void BBDX::BlurCache::buryRenderData(const KWin::EffectWindow *w, const KWin::RenderView *view, BBDX::BlurRenderData &renderData) {
+    if (!renderData.cache || !renderData.cache->valid() || renderData.textures.empty()) {
+        return;
+    }
+
+    // not worth keeping memory around that the system needs
+    if (m_memoryPressure != MemoryPressureMonitor::Level::None) {
+        return;
+    }
+
+    if (m_tombstones.size() >= s_maxTombstones) {
+        m_tombstones.erase(m_tombstones.begin());
+    }
+
+    qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX
+                        << "Burying render data:" << w->windowClass() << "\n"
+                        << "Size:" << renderData.cache->backgroundRect().size();
+
+    m_tombstones.push_back(BlurCacheTombstone{
+        .windowClass = w->windowClass(),
+        .windowType = w->windowType(),
+        .size = renderData.cache->backgroundRect().size(),
+        .view = view,
+        .backgroundRect = renderData.cache->backgroundRect(),
+        .buried = std::chrono::steady_clock::now(),
+        .textures = std::move(renderData.textures),
+        .framebuffers = std::move(renderData.framebuffers),
+        .cache = std::move(renderData.cache),
+    });
+}
+
+void BBDX::BlurCache::reviveRenderData(const KWin::EffectWindow *w, const KWin::RenderView *view, const KWin::Rect &backgroundRect, BBDX::BlurRenderData &renderData) {
+    // newest first, it's the most likely to still be accurate
+    for (auto it = m_tombstones.rbegin(); it != m_tombstones.rend(); ++it) {
+        if (it->view != view
+            || it->size != backgroundRect.size()
+            || it->windowType != w->windowType()
+            || it->windowClass != w->windowClass()) {
+            continue;
+        }
+
+        renderData.textures = std::move(it->textures);
+        renderData.framebuffers = std::move(it->framebuffers);
+        renderData.cache = std::move(it->cache);
+        renderData.cache->rebind(w);
+
+        // the blurred content is only known to be
+        // correct at the exact same position
+        if (it->backgroundRect != backgroundRect) {
+            renderData.cache->invalidate(static_cast<uint>(BlurCacheInvalidationFlag::REGION), "Revived at a different position");
+        }
+
+        qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX
+                            << "Revived render data:" << w->windowClass() << "\n"
+                            << "Size:" << backgroundRect.size();
+
+        m_tombstones.erase(std::next(it).base());
+        return;
+    }
+}
+
+void BBDX::BlurCache::pruneTombstones() {
+    if (m_tombstones.empty()) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    std::erase_if(m_tombstones, [&now](const BlurCacheTombstone &tombstone) {
+        return now - tombstone.buried > s_tombstoneLifetime;
+    });
+}
+
+void BBDX::BlurCache::dropTombstones(KWin::RenderView *view) {
+    if (std::ranges::none_of(m_tombstones, [view](const auto &tombstone) { return tombstone.view == view; })) {
+        return;
+    }
+
+    effects->makeOpenGLContextCurrent();
+
+    std::erase_if(m_tombstones, [view](const BlurCacheTombstone &tombstone) {
+        return tombstone.view == view;
+    });
+}
+
+void BBDX::BlurCache::releaseResources() {
+    if (m_wallpapers.empty() && m_tombstones.empty()) {
+        return;
+    }
+
+    qCDebug(BLUR_CACHE) << BBDX::LOG_PREFIX << "Releasing" << m_wallpapers.size() << "wallpaper buffers and" << m_tombstones.size() << "tombstones";
+
+    for (auto &[view, wallpaper] : m_wallpapers) {
+        disconnect(wallpaper->connection);
+    }
+
+    effects->makeOpenGLContextCurrent();
+
+    m_wallpapers.clear();
+    m_tombstones.clear();
+}
+
+void BBDX::BlurCache::setMemoryPressure(MemoryPressureMonitor::Level level) {
+    if (level == m_memoryPressure) {
+        return;
+    }
+
+    m_memoryPressure = level;
+
+    if (m_memoryPressure != MemoryPressureMonitor::Level::None && !m_tombstones.empty()) {
+        effects->makeOpenGLContextCurrent();
+        m_tombstones.clear();
+    }
+
+    // re-create cache entries and wallpapers with the new scale
+    m_effect->windowManager()->flushAllWindowCaches();
+}
+
+qreal BBDX::BlurCache::cacheScale() const {
+    switch (m_memoryPressure) {
+        case MemoryPressureMonitor::Level::None:
+            return 1.0;
+        case MemoryPressureMonitor::Level::Moderate:
+        case MemoryPressureMonitor::Level::Critical:
+        default:
+            return 0.5;
+    }
+}
+
+qreal BBDX::BlurCache::wallpaperScale() const {
+    switch (m_memoryPressure) {
+        case MemoryPressureMonitor::Level::Critical:
+            return 0.5;
+        case MemoryPressureMonitor::Level::None:
+        case MemoryPressureMonitor::Level::Moderate:
+        default:
+            return 1.0;
+    }
+}
@@ -1,14 +1,19 @@
 #pragma once
 
 #include "kwin_compat.hpp"
+#include "blur_cache_tiles.hpp"
+#include "gpu_timer.hpp"
+#include "memory_pressure_monitor.hpp"
 #include "settings.hpp"
 
 #include <chrono>
+#include <deque>
 #include <core/renderviewport.h>
 #include <effect/effect.h>
 #include <epoxy/gl.h>
 
 #include <QObject>
+#include <QTimer>
 
 #include <effect/effectwindow.h>
 #include <opengl/glframebuffer.h>
@@ -23,6 +28,8 @@
 #endif
 
 #include <memory>
+#include <optional>
+#include <utility>
 
 namespace KWin {
     class GLVertex2D;
@@ -43,12 +50,27 @@ enum class BlurCacheInvalidationFlag : uint {
     FULL = 1 << 0,
 
     /**
-     * only clear cachedRegion
+     * only mark all tiles invalid
      * causing that area to be flushed
      */
     REGION = 1 << 1,
 };
 
+/**
+ * What a BlurCacheEntry shows apart from its window and backgroundRect
+ *
+ * Views with the same key (e.g. mirrored outputs or screencasts)
+ * show the same pixels and share one entry
+ */
+struct BlurCacheKey {
+    // logical area and scale of the view
+    KWin::RectF viewGeometry{};
+    qreal viewScale{1.0};
+    BlitMode blitMode{BlitMode::RENDER_TARGET};
+
+    bool operator==(const BlurCacheKey &other) const = default;
+};
+
 /**
  * A single valid entry
  */
@@ -58,11 +80,38 @@ class BlurCacheEntry {
     std::unique_ptr<KWin::GLTexture> m_cachedTexture{nullptr};
     std::unique_ptr<KWin::GLFramebuffer> m_cachedFramebuffer{nullptr};
 
+    // same size as the cache, target for shifting its content
+    // in translate() and back buffer of asynchronous flushes
+    // (allocated on demand, see releaseScratchBuffer())
+    std::unique_ptr<KWin::GLTexture> m_scratchTexture{nullptr};
+    std::unique_ptr<KWin::GLFramebuffer> m_scratchFramebuffer{nullptr};
+
     /**
-     * Region that has cached data
-     * Updated by flushed()
+     * Asynchronous flush state (see beginAsyncFlush())
+     * m_asyncFlushing while the flush renders into the scratch buffer,
+     * afterwards m_swapFence signals once the GPU is done with it
      */
-    KWin::Region m_cachedRegion{};
+    bool m_asyncFlushing{false};
+    GLsync m_swapFence{nullptr};
+
+    /**
+     * Progressive flush state (see advanceFlush())
+     * next pass to run, 0 while no flush is in progress
+     * and the area it started out to re-blur
+     *
+     * m_lateDamage is what was damaged while it ran,
+     * it stays dirty after the flush completes
+     */
+    size_t m_flushPass{0};
+    KWin::Region m_progressRegion{};
+    KWin::Region m_lateDamage{};
+
+    /**
+     * Valid/dirty state of the cache
+     * valid tiles are updated by flushed()
+     * dirty tiles accumulate since lastFlush
+     */
+    BlurCacheTiles m_tiles{};
 
     /**
      * backgroundRect behind this cache entry
@@ -71,28 +120,67 @@ class BlurCacheEntry {
     KWin::Rect m_backgroundRect{};
 
     /**
-     * dirtyRegion accumulated since lastFlush
-     * in global coordinated
-     * TODO: throw away on geometry change?
+     * Views this entry can be shared with
      * updated by BlurCache::preparePaintData()
      */
-    KWin::Region m_accumulatedDirtyRegion{};
+    BlurCacheKey m_key{};
+
+    /**
+     * Size of cachedTexture relative to backgroundRect
+     * < 1.0 while under memory pressure
+     */
+    qreal m_scale{1.0};
+
     std::chrono::steady_clock::time_point m_lastFlush{};
 
     /**
-     * true if accumulatedDirtyRegion was consumed in prePaintScreen
+     * true if the dirty tiles were consumed in prePaintScreen
      * and we need to to check and potentially re-blur
      *
      * A new cache entry should always flush immediately
      */
     bool m_isFlushing{true};
 
+    /**
+     * Deferrable flush request (see requestFlush())
+     * turned into a flush by BlurCache once the frame budget allows
+     */
+    bool m_flushRequested{false};
+
     /**
      * The cache is always flushed until this is exceeded
      * mostly to ensure animations finish properly
      */
     std::chrono::steady_clock::time_point m_flushingUntil{};
 
+    /**
+     * GPU time of a flush measured with timer queries
+     * (exponential moving average, 0 until the first result is in)
+     */
+    std::unique_ptr<GPUTimer> m_flushTimer{};
+    std::chrono::microseconds m_flushCost{0};
+
+    /**
+     * Minimum time between automatic flushes
+     * assigned by BlurCache when a frame budget is configured
+     */
+    std::optional<std::chrono::microseconds> m_flushInterval{};
+
+    /**
+     * Recent accumulateDirtyRegion() calls damaging a large share
+     * of backgroundRect, used to detect video-like damage behind the window
+     */
+    std::deque<std::chrono::steady_clock::time_point> m_heavyDamage{};
+    bool m_videoDamage{false};
+
+    /**
+     * Damaged area (summed over accumulateDirtyRegion() calls)
+     * since the last flush and when the first of it came in
+     * used to defer flushes for damage too small to be seen through the blur
+     */
+    qreal m_damageArea{0.0};
+    std::chrono::steady_clock::time_point m_firstDamage{};
+
     /**
      * Marks this cache entry invalid (purging it the next paint cycle)
      *
@@ -114,6 +202,17 @@ class BlurCacheEntry {
      */
     BlurCacheEntry() = default;
 
+    /**
+     * Allocate the scratch texture + framebuffer if needed
+     * false on failure
+     */
+    bool ensureScratchBuffer();
+
+    /**
+     * Make the scratch buffer the cache
+     */
+    void swapBuffers();
+
 public:
     /**
      * Create a new BlurCacheEntry by allocating cachedTexture and cachedFramebuffer
@@ -121,10 +220,13 @@ public:
      *
      * The limiting factor in terms of quality definitely is the blit itself anyways
      * (logical un-scaled pixels) so un-scaled backgroundRect should be sufficient
+     *
+     * scale shrinks the cached texture further e.g. under memory pressure
      */
     static std::unique_ptr<BlurCacheEntry> create(const KWin::Rect &backgroundRect,
                                                   GLenum internalFormat,
-                                                  const KWin::EffectWindow *window);
+                                                  const KWin::EffectWindow *window,
+                                                  qreal scale = 1.0);
 
     /**
      * Disallow copying GL resources
@@ -132,16 +234,113 @@ public:
     BlurCacheEntry(BlurCacheEntry &other) = delete;
     BlurCacheEntry& operator=(BlurCacheEntry &other) = delete;
 
+    /**
+     * Expects the OpenGL context to be current
+     */
+    ~BlurCacheEntry();
+
+    /**
+     * Whether the cached texture fits backgroundRect and internalFormat
+     */
+    bool matches(const KWin::Rect &backgroundRect, GLenum internalFormat) const;
+
     /**
      * Check if the dirtyRegion is fully cached
      */
     bool hasCachedRegion(const KWin::Region &dirtyRegion) const;
 
     /**
-     * Add dirtyRegion to accumulatedDirtyRegion
+     * Mark tiles overlapped by dirtyRegion dirty
      */
     void accumulateDirtyRegion(const KWin::Region &dirtyRegion);
 
+    /**
+     * Whether the area behind this entry is damaged like a playing video
+     * i.e. large parts of it every frame for a while
+     *
+     * Stays set for a short cooldown after the damage stopped
+     */
+    bool hasVideoDamage() const;
+
+    /**
+     * Whether the damage since the last flush is likely visible
+     * after blurring with a kernel covering kernelArea pixels
+     * or has waited for longer than maxStaleness
+     */
+    bool hasSignificantDamage(qreal kernelArea, std::chrono::milliseconds maxStaleness) const;
+
+    /**
+     * Dirty tiles in global coordinates
+     * grown by halo pixels i.e. what a flush needs to re-blur
+     */
+    KWin::Region flushRegion(int halo) const;
+
+    /**
+     * Region covered by invalid tiles in global coordinates
+     * grown by halo pixels i.e. what a flush needs to fill in
+     */
+    KWin::Region invalidRegion(int halo) const;
+
+    /**
+     * Follow a pure move of backgroundRect to rect
+     * by shifting the cached content along with it
+     *
+     * Afterwards only the newly exposed parts
+     * and their halo pixels are invalid.
+     *
+     * Returns whether the cached content was shifted
+     *
+     * Expects the OpenGL context to be current
+     */
+    bool translate(const KWin::Rect &rect, int halo);
+
+    /**
+     * Drop the scratch buffer (doubling the entry's memory)
+     * unless an asynchronous flush still uses it
+     *
+     * Expects the OpenGL context to be current
+     */
+    void releaseScratchBuffer();
+
+    /**
+     * Double buffered flushes
+     *
+     * beginAsyncFlush() copies the cache into the back buffer
+     * which the flush renders into (see flushFramebuffer()) while
+     * the cache keeps being drawn. endAsyncFlush() fences the flush,
+     * swapIfReady() swaps once the fence signalled.
+     * finishAsyncFlush() swaps right away e.g. before the content is moved,
+     * GL command order keeps that correct, it just may stall.
+     *
+     * Expect the OpenGL context to be current
+     */
+    bool beginAsyncFlush();
+    void endAsyncFlush();
+    bool swapIfReady();
+    void finishAsyncFlush();
+    bool swapPending() const { return m_swapFence != nullptr; }
+
+    /**
+     * Progressive flushes
+     *
+     * advanceFlush() hands out the passes [first, end) of totalPasses
+     * to run this frame, at most passesPerFrame of them (0 = all).
+     * flushed() only completes the flush once the last pass ran.
+     *
+     * startProgress() remembers the area the flush re-blurs
+     * so later frames continue with (and finally mark valid) the same one
+     */
+    std::pair<size_t, size_t> advanceFlush(size_t passesPerFrame, size_t totalPasses);
+    void startProgress(const KWin::Region &flushRegion);
+    bool flushInProgress() const { return m_flushPass > 0; }
+    const KWin::Region& progressRegion() const { return m_progressRegion; }
+
+    /**
+     * Drop the progress of a progressive flush
+     * so the next frame starts it over
+     */
+    void resetProgress();
+
     /**
      * Mark this entry for flushing
      *
@@ -151,6 +350,12 @@ public:
     void abortFlush(const char *msg = nullptr);
     void flushed(const BlurCachePaintData &paintData);
 
+    /**
+     * Like flush() but may be deferred to a later frame
+     * by the flush scheduler in BlurCache
+     */
+    void requestFlush(const char *msg = nullptr);
+
     /**
      * Like flush() but keeps the flush alive for
      * the given duration (mostly to ensure animations complete)
@@ -162,6 +367,22 @@ public:
      */
     void maybeExtendFlush();
 
+    /**
+     * Enclose the GL commands of a flush to measure its GPU cost
+     *
+     * Expects the OpenGL context to be current
+     */
+    void beginFlushTiming();
+    void endFlushTiming();
+
+    /**
+     * Fold finished timer query results into flushCost
+     * returns the new measurement if there was one
+     *
+     * Expects the OpenGL context to be current
+     */
+    std::optional<std::chrono::microseconds> updateFlushCost();
+
     /**
      * Invalidate cache entry
      *
@@ -169,19 +390,37 @@ public:
      */
     void invalidate(uint flags = static_cast<uint>(BlurCacheInvalidationFlag::FULL), const char *msg = nullptr);
 
+    /**
+     * Re-associate this entry with a new window
+     * e.g. when reusing it from a BlurCacheTombstone
+     */
+    void rebind(const KWin::EffectWindow *window);
+
     /**
      * Setters
      */
-    void setBackgroundRect(const KWin::Rect &rect) { m_backgroundRect = rect; }
+    void setBackgroundRect(const KWin::Rect &rect);
+    void setKey(const BlurCacheKey &key) { m_key = key; }
+    void setFlushInterval(std::optional<std::chrono::microseconds> interval) { m_flushInterval = interval; }
 
     /**
      * Getters
      */
     KWin::GLTexture* cachedTexture() const { return m_cachedTexture.get(); }
     KWin::GLFramebuffer* cachedFramebuffer() const { return m_cachedFramebuffer.get(); }
-    const KWin::Region& accumulatedDirtyRegion() const { return m_accumulatedDirtyRegion; }
+    // where the flush in progress renders to
+    // the back buffer while flushing asynchronously
+    KWin::GLTexture* flushTexture() const { return m_asyncFlushing ? m_scratchTexture.get() : m_cachedTexture.get(); }
+    KWin::GLFramebuffer* flushFramebuffer() const { return m_asyncFlushing ? m_scratchFramebuffer.get() : m_cachedFramebuffer.get(); }
+    const KWin::Rect& backgroundRect() const { return m_backgroundRect; }
+    const BlurCacheKey& key() const { return m_key; }
+    qreal scale() const { return m_scale; }
+    KWin::Region accumulatedDirtyRegion() const;
     const std::chrono::steady_clock::time_point& lastFlush() const { return m_lastFlush; }
     bool isFlushing() const { return m_isFlushing; }
+    bool flushRequested() const { return m_flushRequested; }
+    std::chrono::microseconds flushCost() const { return m_flushCost; }
+    std::optional<std::chrono::microseconds> flushInterval() const { return m_flushInterval; }
     bool valid() const { return m_valid; }
 };
 
@@ -195,12 +434,24 @@ struct BlurCachePaintData {
     const KWin::Rect *scaledBackgroundRect;
     KWin::GLFramebuffer *blitFramebuffer;
 
-    // the shape used in drawToCache
-    QList<KWin::Rect> cacheShape;
+    // area hidden under the window's own opaque content
+    // never re-blurred (see BlurEffect::opaqueSkipRegion())
+    const KWin::Region *skipRegion;
+
+    // area re-blurred while flushing (global)
+    // i.e. dirtyRegion and the kernel halo of dirty tiles minus skipRegion
+    // marked valid once the flush completed
+    KWin::Region flushRegion;
+
+    // blur passes per frame of a progressive flush of this entry, 0 = all at once
+    // only progressive while the entry has complete content to show meanwhile
+    size_t progressivePasses{0};
 };
 
 struct WallpaperData {
     KWin::RectF geometry;
+    // texture size relative to geometry
+    qreal scale{1.0};
     std::unique_ptr<KWin::GLFramebuffer> framebuffer;
     std::unique_ptr<KWin::GLTexture> texture;
 
@@ -212,6 +463,28 @@ struct WallpaperData {
     QMetaObject::Connection connection;
 };
 
+/**
+ * Render data of a recently closed popup window
+ * kept around for reuse by the next matching popup
+ */
+struct BlurCacheTombstone {
+    // reuse key
+    QString windowClass;
+    KWin::WindowType windowType;
+    QSize size;
+    const KWin::RenderView *view;
+
+    // last backgroundRect of the closed window
+    // the blurred content is only reused if this matches
+    KWin::Rect backgroundRect;
+    std::chrono::steady_clock::time_point buried;
+
+    // moved out of the closed window's BlurRenderData
+    std::vector<std::unique_ptr<KWin::GLTexture>> textures;
+    std::vector<std::unique_ptr<KWin::GLFramebuffer>> framebuffers;
+    std::shared_ptr<BlurCacheEntry> cache;
+};
+
 class BlurCache : public QObject {
     Q_OBJECT
 private:
@@ -231,7 +504,12 @@ private:
     /**
      * Wallpaper buffers for wallpaper mode
      */
-    std::unordered_map<KWin::RenderView *, WallpaperData> m_wallpapers{};
+    std::unordered_map<KWin::RenderView *, std::shared_ptr<WallpaperData>> m_wallpapers{};
+
+    /**
+     * Render data of recently closed popups, oldest first
+     */
+    std::vector<BlurCacheTombstone> m_tombstones{};
 
     /**
      * User settings
@@ -239,12 +517,58 @@ private:
     BlitMode m_blitMode{BlitMode::RENDER_TARGET};
     bool m_ignoreCache{false};
     std::chrono::milliseconds m_cacheRateLimit{0};
+    std::chrono::microseconds m_cacheFrameBudget{0};
+    std::chrono::milliseconds m_maxStaleness{0};
+    size_t m_progressivePasses{0};
+
+    /**
+     * Current system memory pressure
+     * set by BlurEffect via setMemoryPressure()
+     */
+    MemoryPressureMonitor::Level m_memoryPressure{MemoryPressureMonitor::Level::None};
 
     /**
      * use create()
      */
     BlurCache() = default;
 
+    /**
+     * Derive per-entry flush intervals for the given view
+     * that keep the summed flush cost per frame under m_cacheFrameBudget
+     */
+    void scheduleFlushIntervals(const KWin::RenderView *view) const;
+
+    /**
+     * Deferrable flush waiting for budget
+     */
+    struct FlushCandidate {
+        BlurCacheEntry *entry;
+        bool visible;
+    };
+
+    /**
+     * GPU time per frame available for flushes on view
+     * and the (measured or estimated) cost of flushing an entry
+     */
+    std::chrono::microseconds flushBudget(const KWin::RenderView *view) const;
+    std::chrono::microseconds estimatedFlushCost(const BlurCacheEntry *entry) const;
+
+    /**
+     * A valid entry of window on another view than view
+     * showing the same content, nullptr if there is none
+     */
+    std::shared_ptr<BlurCacheEntry> findSharedEntry(const KWin::EffectWindow *window,
+                                                    const KWin::RenderView *view,
+                                                    const BlurCacheKey &key,
+                                                    const KWin::Rect &backgroundRect,
+                                                    GLenum internalFormat) const;
+
+    /**
+     * Fires once video-like damage stopped everywhere
+     * so the affected windows get repainted at full quality
+     */
+    QTimer m_videoDamageTimer{};
+
 public Q_SLOTS:
     /**
      * Called whenever a wallpaper window marks itself damaged
@@ -269,11 +593,31 @@ public:
     BlitMode blitMode() const { return m_blitMode; }
     bool ignoreCache() const { return m_ignoreCache; }
     std::chrono::milliseconds cacheRateLimit() const { return m_cacheRateLimit; }
+    std::chrono::microseconds cacheFrameBudget() const { return m_cacheFrameBudget; }
+    // blur passes per frame of the current entry's progressive flush, 0 = all at once
+    size_t progressivePasses() const { return m_paintData.progressivePasses; }
+    const KWin::Region& flushRegion() const { return m_paintData.flushRegion; }
+
+    /**
+     * React to system memory pressure
+     *
+     * Drops tombstones and shrinks cache entries and wallpapers
+     * (new sizes are picked up lazily on the next flush)
+     *
+     * Ensures the OpenGL context is current
+     */
+    void setMemoryPressure(MemoryPressureMonitor::Level level);
+
+    /**
+     * Texture scales for the current memory pressure
+     */
+    qreal cacheScale() const;
+    qreal wallpaperScale() const;
 
     /**
      * Prepare the cache for this paint
-     * and create an entry in the given cache unique_ptr if
-     * one doesn't exist already
+     * and create an entry in the given cache shared_ptr if
+     * one doesn't exist already (or share one with another view)
      */
     void preparePaintData(const KWin::RenderTarget *renderTarget,
                           const KWin::RenderViewport *viewport,
@@ -283,7 +627,8 @@ public:
                           KWin::GLFramebuffer *blitFramebuffer,
                           const KWin::Rect *backgroundRect,
                           const KWin::Rect *scaledBackgroundRect,
-                          std::unique_ptr<BlurCacheEntry> &cache);
+                          const KWin::Region *skipRegion,
+                          std::shared_ptr<BlurCacheEntry> &cache);
 
     /**
      * Start indices and vert count of stuff in the VBO
@@ -304,8 +649,19 @@ public:
      */
     void drawToCache(BBDX::BlurCacheEntry *cache, KWin::GLVertexBuffer *vbo) const;
 
+    /**
+     * Whether the flush of cache may render into its back buffer
+     * i.e. the cache has something to show meanwhile
+     * and there is memory to spare for a second texture
+     */
+    bool asyncFlushAllowed(const BBDX::BlurCacheEntry *cache) const;
+
     /**
      * Flush all window's accumulatedDirtyRegions
+     *
+     * Deferrable flushes (rate limit, requestFlush()) are ordered
+     * by visibility and staleness and limited to a per-frame budget,
+     * the rest waits for later frames
      */
     void flushAccumulatedDirtyRegions(KWin::ScreenPrePaintData &data) const;
 
@@ -322,6 +678,49 @@ public:
      * Ensures the OpenGL context is current
      */
     void dropWallpaper(KWin::RenderView *view);
+
+    /**
+     * Whether render data of this window is worth keeping
+     * after it was closed (menus, tooltips and other popups)
+     */
+    static bool isTombstoneCandidate(const KWin::EffectWindow *w);
+
+    /**
+     * Move the render data of a closed window into a tombstone
+     *
+     * Expects the OpenGL context to be current as this
+     * may evict older tombstones
+     */
+    void buryRenderData(const KWin::EffectWindow *w, const KWin::RenderView *view, BBDX::BlurRenderData &renderData);
+
+    /**
+     * Move the render data of a matching tombstone into renderData
+     *
+     * The cached region is only kept if backgroundRect is unchanged
+     */
+    void reviveRenderData(const KWin::EffectWindow *w, const KWin::RenderView *view, const KWin::Rect &backgroundRect, BBDX::BlurRenderData &renderData);
+
+    /**
+     * Drop expired tombstones
+     *
+     * Expects the OpenGL context to be current
+     */
+    void pruneTombstones();
+
+    /**
+     * Drop tombstones e.g. when the view was removed
+     *
+     * Ensures the OpenGL context is current
+     */
+    void dropTombstones(KWin::RenderView *view);
+
+    /**
+     * Drop all wallpapers and tombstones
+     * e.g. while the screen is locked or all outputs are off
+     *
+     * Ensures the OpenGL context is current
+     */
+    void releaseResources();
 };
 
 } // namespace BBDX
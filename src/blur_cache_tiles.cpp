@@ -0,0 +1,251 @@
+#include "blur_cache_tiles.hpp"
+
+#include "kwin_compat.hpp"
+
+#if KWIN_VERSION >= KWIN_VERSION_CODE(6, 5, 80)
+#  include <core/rect.h>
+#  include <core/region.h>
+#endif
+
+#include <algorithm>
+
+KWin::Rect BBDX::BlurCacheTiles::tileRect(int column, int row) const {
+    const int x = column * s_tileSize;
+    const int y = row * s_tileSize;
+    return KWin::Rect{x, y, std::min(s_tileSize, m_size.width() - x), std::min(s_tileSize, m_size.height() - y)};
+}
+
+bool BBDX::BlurCacheTiles::tileRange(const KWin::Rect &rect, int &column0, int &row0, int &column1, int &row1) const {
+    const int left = std::max(0, rect.x());
+    const int top = std::max(0, rect.y());
+    const int right = std::min(m_size.width(), rect.x() + rect.width());
+    const int bottom = std::min(m_size.height(), rect.y() + rect.height());
+
+    if (left >= right || top >= bottom) {
+        return false;
+    }
+
+    column0 = left / s_tileSize;
+    row0 = top / s_tileSize;
+    column1 = (right - 1) / s_tileSize;
+    row1 = (bottom - 1) / s_tileSize;
+    return true;
+}
+
+void BBDX::BlurCacheTiles::resize(const QSize &size) {
+    if (size == m_size) {
+        return;
+    }
+
+    m_size = size;
+    m_columns = (size.width() + s_tileSize - 1) / s_tileSize;
+    m_rows = (size.height() + s_tileSize - 1) / s_tileSize;
+
+    const size_t tiles = static_cast<size_t>(std::max(0, m_columns * m_rows));
+    const size_t words = (tiles + 63) / 64;
+    m_valid.assign(words, 0);
+    m_dirty.assign(words, 0);
+}
+
+void BBDX::BlurCacheTiles::markDirty(const KWin::Region &region) {
+    int column0, row0, column1, row1;
+    for (const auto &rect : region.rects()) {
+        if (!tileRange(rect, column0, row0, column1, row1)) {
+            continue;
+        }
+
+        for (int row = row0; row <= row1; ++row) {
+            for (int column = column0; column <= column1; ++column) {
+                setBit(m_dirty, row * m_columns + column);
+            }
+        }
+    }
+}
+
+void BBDX::BlurCacheTiles::markFlushed(const KWin::Region &region) {
+    // region is split into bands (e.g. at occluder edges) so a tile is
+    // often covered by several rects, those never overlap though
+    // so summing up their area per tile tells if it's fully covered
+    std::vector<int> coveredArea(static_cast<size_t>(m_columns * m_rows), 0);
+
+    int column0, row0, column1, row1;
+    for (const auto &rect : region.rects()) {
+        if (!tileRange(rect, column0, row0, column1, row1)) {
+            continue;
+        }
+
+        for (int row = row0; row <= row1; ++row) {
+            for (int column = column0; column <= column1; ++column) {
+                const KWin::Rect covered = rect.intersected(tileRect(column, row));
+                coveredArea[row * m_columns + column] += covered.width() * covered.height();
+            }
+        }
+    }
+
+    for (int row = 0; row < m_rows; ++row) {
+        for (int column = 0; column < m_columns; ++column) {
+            const size_t tile = row * m_columns + column;
+            const KWin::Rect rect = tileRect(column, row);
+
+            // partially covered tiles still have uncached pixels
+            if (coveredArea[tile] < rect.width() * rect.height()) {
+                continue;
+            }
+
+            setBit(m_valid, tile);
+            clearBit(m_dirty, tile);
+        }
+    }
+}
+
+void BBDX::BlurCacheTiles::invalidate() {
+    std::ranges::fill(m_valid, 0);
+}
+
+bool BBDX::BlurCacheTiles::covers(const KWin::Region &region) const {
+    int column0, row0, column1, row1;
+    for (const auto &rect : region.rects()) {
+        if (!tileRange(rect, column0, row0, column1, row1)) {
+            continue;
+        }
+
+        for (int row = row0; row <= row1; ++row) {
+            for (int column = column0; column <= column1; ++column) {
+                if (!testBit(m_valid, row * m_columns + column)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool BBDX::BlurCacheTiles::isDirty() const {
+    return std::ranges::any_of(m_dirty, [](uint64_t word) { return word != 0; });
+}
+
+KWin::Region BBDX::BlurCacheTiles::dirtyRegion() const {
+    return dirtyRegionWithHalo(0);
+}
+
+KWin::Region BBDX::BlurCacheTiles::dirtyRegionWithHalo(int halo) const {
+    if (!isDirty()) {
+        return KWin::Region{};
+    }
+
+    return regionWithHalo(m_dirty, true, halo);
+}
+
+KWin::Region BBDX::BlurCacheTiles::invalidRegionWithHalo(int halo) const {
+    return regionWithHalo(m_valid, false, halo);
+}
+
+KWin::Region BBDX::BlurCacheTiles::regionWithHalo(const std::vector<uint64_t> &bits, bool set, int halo) const {
+    KWin::Region region{};
+
+    const int haloTiles = (std::max(0, halo) + s_tileSize - 1) / s_tileSize;
+
+    // one rect per horizontal run of (grown) matching tiles
+    std::vector<bool> grown(static_cast<size_t>(m_columns), false);
+    for (int row = 0; row < m_rows; ++row) {
+        std::fill(grown.begin(), grown.end(), false);
+
+        const int neighbour0 = std::max(0, row - haloTiles);
+        const int neighbour1 = std::min(m_rows - 1, row + haloTiles);
+        for (int neighbour = neighbour0; neighbour <= neighbour1; ++neighbour) {
+            for (int column = 0; column < m_columns; ++column) {
+                if (testBit(bits, neighbour * m_columns + column) != set) {
+                    continue;
+                }
+
+                const int column0 = std::max(0, column - haloTiles);
+                const int column1 = std::min(m_columns - 1, column + haloTiles);
+                for (int grownColumn = column0; grownColumn <= column1; ++grownColumn) {
+                    grown[grownColumn] = true;
+                }
+            }
+        }
+
+        for (int column = 0; column < m_columns;) {
+            if (!grown[column]) {
+                ++column;
+                continue;
+            }
+
+            const int runStart = column;
+            while (column < m_columns && grown[column]) {
+                ++column;
+            }
+
+            const KWin::Rect first = tileRect(runStart, row);
+            const KWin::Rect last = tileRect(column - 1, row);
+            region |= KWin::Rect{first.x(), first.y(), last.x() + last.width() - first.x(), first.height()};
+        }
+    }
+
+    return region;
+}
+
+bool BBDX::BlurCacheTiles::testRange(const std::vector<uint64_t> &bits, const KWin::Rect &rect, bool all) const {
+    int column0, row0, column1, row1;
+    if (!tileRange(rect, column0, row0, column1, row1)) {
+        return all;
+    }
+
+    for (int row = row0; row <= row1; ++row) {
+        for (int column = column0; column <= column1; ++column) {
+            if (testBit(bits, row * m_columns + column) != all) {
+                return !all;
+            }
+        }
+    }
+
+    return all;
+}
+
+void BBDX::BlurCacheTiles::translate(const QPoint &offset, int halo) {
+    if (offset.isNull()) {
+        return;
+    }
+
+    const auto oldValid = m_valid;
+    const auto oldDirty = m_dirty;
+    std::ranges::fill(m_valid, 0);
+    std::ranges::fill(m_dirty, 0);
+
+    const KWin::Rect bounds{0, 0, m_size.width(), m_size.height()};
+    for (int row = 0; row < m_rows; ++row) {
+        for (int column = 0; column < m_columns; ++column) {
+            const size_t tile = row * m_columns + column;
+            const KWin::Rect rect = tileRect(column, row);
+            const KWin::Rect grown = rect.adjusted(-halo, -halo, halo, halo);
+            const KWin::Rect source = rect.translated(-offset);
+
+            // state follows the content
+            if (testRange(oldDirty, source, false)) {
+                setBit(m_dirty, tile);
+            }
+
+            // content from outside the old grid
+            if (!bounds.contains(source)) {
+                continue;
+            }
+
+            // the blur clamps at the texture borders so
+            // near a border that moved the result differs
+            const bool crossesX = grown.x() < 0 || grown.x() + grown.width() > m_size.width();
+            const bool crossesY = grown.y() < 0 || grown.y() + grown.height() > m_size.height();
+            if ((crossesX && offset.x() != 0) || (crossesY && offset.y() != 0)) {
+                continue;
+            }
+
+            const KWin::Rect kernelSource = grown.intersected(bounds).translated(-offset);
+            if (!bounds.contains(kernelSource) || !testRange(oldValid, kernelSource, true)) {
+                continue;
+            }
+
+            setBit(m_valid, tile);
+        }
+    }
+}
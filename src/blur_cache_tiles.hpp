@@ -0,0 +1,134 @@
+#pragma once
+
+#include "kwin_compat.hpp"
+
+#include <QPoint>
+#include <QSize>
+
+#if KWIN_VERSION >= KWIN_VERSION_CODE(6, 5, 80)
+#  include <core/rect.h>
+#  include <core/region.h>
+#endif
+
+#include <cstdint>
+#include <vector>
+
+namespace BBDX {
+
+/**
+ * Fixed grid of tiles covering a BlurCacheEntry
+ * tracking which parts of the cache are valid/dirty
+ *
+ * All coordinates are local to the entry's backgroundRect.
+ * Checks are bit operations on the grid instead of
+ * Region unions that degrade with fragmented damage.
+ */
+class BlurCacheTiles {
+public:
+    // logical pixels
+    static constexpr int s_tileSize{64};
+
+private:
+    QSize m_size{};
+    int m_columns{0};
+    int m_rows{0};
+
+    // one bit per tile, row-major
+    std::vector<uint64_t> m_valid{};
+    std::vector<uint64_t> m_dirty{};
+
+    /**
+     * Bit helpers
+     */
+    static bool testBit(const std::vector<uint64_t> &bits, size_t tile) { return bits[tile / 64] & (uint64_t{1} << (tile % 64)); }
+    static void setBit(std::vector<uint64_t> &bits, size_t tile) { bits[tile / 64] |= uint64_t{1} << (tile % 64); }
+    static void clearBit(std::vector<uint64_t> &bits, size_t tile) { bits[tile / 64] &= ~(uint64_t{1} << (tile % 64)); }
+
+    /**
+     * Region covered by tiles whose bit equals set
+     * grown by halo pixels (rounded up to full tiles)
+     */
+    KWin::Region regionWithHalo(const std::vector<uint64_t> &bits, bool set, int halo) const;
+
+    /**
+     * Whether any tile overlapped by rect has its bit set
+     * (all instead of any if all is true)
+     */
+    bool testRange(const std::vector<uint64_t> &bits, const KWin::Rect &rect, bool all) const;
+
+    /**
+     * Tile rect clipped to m_size
+     */
+    KWin::Rect tileRect(int column, int row) const;
+
+    /**
+     * Inclusive tile range overlapped by rect
+     * false if rect doesn't overlap the grid at all
+     */
+    bool tileRange(const KWin::Rect &rect, int &column0, int &row0, int &column1, int &row1) const;
+
+public:
+    /**
+     * (Re-)Initialize the grid for the given size
+     * dropping all state if the size changed
+     */
+    void resize(const QSize &size);
+
+    /**
+     * Mark all tiles overlapped by region dirty
+     */
+    void markDirty(const KWin::Region &region);
+
+    /**
+     * Mark tiles fully covered by region (as a whole, not just
+     * by a single rect of it) valid and clear their dirty bits
+     *
+     * region is what the flush actually rendered,
+     * partially covered tiles keep their state
+     */
+    void markFlushed(const KWin::Region &region);
+
+    /**
+     * Mark all tiles invalid
+     */
+    void invalidate();
+
+    /**
+     * Whether every tile overlapped by region is valid
+     */
+    bool covers(const KWin::Region &region) const;
+
+    /**
+     * Whether any tile is dirty
+     */
+    bool isDirty() const;
+
+    /**
+     * Region covered by dirty tiles
+     */
+    KWin::Region dirtyRegion() const;
+
+    /**
+     * Region covered by dirty tiles grown by halo pixels (rounded up to full tiles)
+     * i.e. everything a re-blur of the dirty tiles can affect
+     */
+    KWin::Region dirtyRegionWithHalo(int halo) const;
+
+    /**
+     * Region covered by invalid tiles grown by halo pixels
+     * i.e. everything a re-blur of the invalid tiles can affect
+     */
+    KWin::Region invalidRegionWithHalo(int halo) const;
+
+    /**
+     * Shift the grid's state by offset pixels after the cached
+     * content was moved by the same amount
+     *
+     * Tiles that now show content from outside the old grid or
+     * whose kernel (halo pixels around them) crosses a moved border
+     * become invalid, everything else keeps its state.
+     */
+    void translate(const QPoint &offset, int halo);
+};
+
+} // namespace BBDX
@@ -0,0 +1,153 @@
+#include "blur_dependency_graph.hpp"
+
+#include "kwin_compat.hpp"
+
+#include "blur_cache.hpp"
+#include "utils.h"
+
+#include <effect/effectwindow.h>
+
+#include <QLoggingCategory>
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(BLUR_DEPENDENCY_GRAPH, "kwin_effect_better_blur_dx.blur_dependency_graph", QtInfoMsg)
+
+KWin::Region BBDX::BlurDependencyGraph::update(const KWin::RenderView *view, std::vector<Node> nodes, int halo) {
+    auto &state = m_views[view];
+    KWin::Region repaint{};
+
+    // restacking: overlapping pairs that switched order
+    // now see a different background in their overlap
+    std::unordered_map<const KWin::EffectWindow *, size_t> oldPositions{};
+    oldPositions.reserve(state.nodes.size());
+    for (size_t i = 0; i < state.nodes.size(); ++i) {
+        oldPositions.emplace(state.nodes[i].window, i);
+    }
+
+    for (size_t lower = 0; lower < nodes.size(); ++lower) {
+        const auto oldLower = oldPositions.find(nodes[lower].window);
+        if (oldLower == oldPositions.end()) {
+            continue;
+        }
+
+        for (size_t upper = lower + 1; upper < nodes.size(); ++upper) {
+            const auto oldUpper = oldPositions.find(nodes[upper].window);
+            if (oldUpper == oldPositions.end() || oldUpper->second > oldLower->second) {
+                continue;
+            }
+
+            const KWin::Rect overlap = nodes[lower].backgroundRect.intersected(nodes[upper].backgroundRect);
+            if (overlap.isEmpty()) {
+                continue;
+            }
+
+            qCDebug(BLUR_DEPENDENCY_GRAPH) << BBDX::LOG_PREFIX
+                                           << "Stacking order flipped:" << nodes[lower].window->windowClass()
+                                           << "<->" << nodes[upper].window->windowClass();
+            nodes[lower].entry->accumulateDirtyRegion(KWin::Region(overlap));
+            nodes[upper].entry->accumulateDirtyRegion(KWin::Region(overlap));
+            repaint += overlap;
+        }
+    }
+
+    // bottom to top so a flushing window picks up
+    // what changed below it before passing its own change on
+    for (size_t lower = 0; lower < nodes.size(); ++lower) {
+        if (!nodes[lower].flushing) {
+            continue;
+        }
+
+        const KWin::Region changed = nodes[lower].entry->flushRegion(halo) & nodes[lower].backgroundRect;
+        if (changed.isEmpty()) {
+            continue;
+        }
+
+        for (size_t upper = lower + 1; upper < nodes.size(); ++upper) {
+            const KWin::Region dependent = changed & nodes[upper].backgroundRect;
+            if (dependent.isEmpty()) {
+                continue;
+            }
+
+            nodes[upper].entry->accumulateDirtyRegion(dependent);
+            repaint += dependent;
+        }
+    }
+
+    // entries may be replaced before the next update()
+    for (auto &node : nodes) {
+        node.entry = nullptr;
+    }
+    state.nodes = std::move(nodes);
+    state.paintedDamage = KWin::Region();
+    state.hasFrameDamage = false;
+    state.damageBelow.clear();
+
+    return repaint;
+}
+
+void BBDX::BlurDependencyGraph::setFrameDamage(const KWin::RenderView *view, const KWin::Region &damage) {
+    if (auto it = m_views.find(view); it != m_views.end()) {
+        it->second.paintedDamage = damage;
+        it->second.hasFrameDamage = true;
+    }
+}
+
+void BBDX::BlurDependencyGraph::addWindowDamage(const KWin::RenderView *view, const KWin::EffectWindow *window, const KWin::Region &damage) {
+    const auto it = m_views.find(view);
+    if (it == m_views.end() || !it->second.hasFrameDamage) {
+        return;
+    }
+
+    auto &state = it->second;
+    state.damageBelow.insert_or_assign(window, state.paintedDamage);
+    state.paintedDamage += damage;
+}
+
+KWin::Region BBDX::BlurDependencyGraph::stableRegion(const KWin::RenderView *view, const KWin::EffectWindow *window) const {
+    // without knowing what was painted nothing is stable
+    const auto it = m_views.find(view);
+    if (it == m_views.end() || !it->second.hasFrameDamage) {
+        return KWin::Region();
+    }
+
+    const auto damageBelow = it->second.damageBelow.find(window);
+    if (damageBelow == it->second.damageBelow.end()) {
+        return KWin::Region();
+    }
+
+    const auto &nodes = it->second.nodes;
+    const auto self = std::ranges::find(nodes, window, &Node::window);
+    if (self == nodes.end()) {
+        return KWin::Region();
+    }
+
+    KWin::Region stable{};
+    for (auto below = nodes.begin(); below != self; ++below) {
+        if (below->flushing) {
+            continue;
+        }
+
+        const KWin::Rect overlap = below->backgroundRect.intersected(self->backgroundRect);
+        if (!overlap.isEmpty()) {
+            stable += overlap;
+        }
+    }
+
+    // anything actually painted there (e.g. the content
+    // of the window below) still has to be re-blurred
+    return stable - damageBelow->second;
+}
+
+void BBDX::BlurDependencyGraph::dropView(const KWin::RenderView *view) {
+    m_views.erase(view);
+}
+
+void BBDX::BlurDependencyGraph::dropWindow(const KWin::EffectWindow *window) {
+    for (auto &[view, state] : m_views) {
+        std::erase_if(state.nodes, [window](const Node &node) {
+            return node.window == window;
+        });
+        state.damageBelow.erase(window);
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "kwin_compat.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+#if KWIN_VERSION >= KWIN_VERSION_CODE(6, 5, 80)
+#  include <core/rect.h>
+#  include <core/region.h>
+#endif
+
+namespace KWin {
+    class EffectWindow;
+#if !defined(BBDX_X11)
+    class RenderView;
+#endif
+}
+
+namespace BBDX {
+
+class BlurCacheEntry;
+
+/**
+ * Per view dependencies between stacked blurred windows
+ *
+ * A blurred window sees the blur of every blurred window below it
+ * that overlaps its backgroundRect. Instead of re-blurring it whenever
+ * anything below gets repainted the graph tracks what actually changed:
+ *
+ * - a flushing window marks exactly its changed area dirty
+ *   in the windows above it
+ * - areas of non-flushing windows below that weren't damaged
+ *   this frame show the same pixels as before and stay cached
+ * - restacking only invalidates the overlap of pairs
+ *   whose order flipped
+ */
+class BlurDependencyGraph {
+public:
+    struct Node {
+        const KWin::EffectWindow *window;
+        // only valid during update()
+        BlurCacheEntry *entry;
+        KWin::Rect backgroundRect;
+        bool flushing;
+    };
+
+private:
+    struct ViewState {
+        // bottom to top
+        std::vector<Node> nodes{};
+
+        // everything painted so far this frame apart from
+        // repaints expanded for blur, screen damage first
+        // then each window's in prePaintWindow() order
+        KWin::Region paintedDamage{};
+        bool hasFrameDamage{false};
+
+        // what was painted below each window (see addWindowDamage())
+        std::unordered_map<const KWin::EffectWindow *, KWin::Region> damageBelow{};
+    };
+
+    std::unordered_map<const KWin::RenderView *, ViewState> m_views{};
+
+public:
+    /**
+     * Rebuild the graph of view from its blurred windows
+     * after the flush decisions of this frame were made
+     *
+     * nodes must be ordered bottom to top.
+     * Marks the changed area of flushing windows and the overlap
+     * of restacked pairs dirty in the affected entries.
+     *
+     * Returns the area that needs a repaint for that
+     */
+    KWin::Region update(const KWin::RenderView *view, std::vector<Node> nodes, int halo);
+
+    /**
+     * Damage of the current frame on view
+     * from BlurEffect::prePaintScreen()
+     */
+    void setFrameDamage(const KWin::RenderView *view, const KWin::Region &damage);
+
+    /**
+     * Damage of window on view from BlurEffect::prePaintWindow()
+     * before it gets expanded for blur
+     *
+     * Must be called bottom to top, the damage of windows below
+     * never makes it into the screen damage of setFrameDamage()
+     */
+    void addWindowDamage(const KWin::RenderView *view, const KWin::EffectWindow *window, const KWin::Region &damage);
+
+    /**
+     * Area of window's backgroundRect on view that only shows
+     * unchanged cached blur of windows below it this frame
+     * i.e. repaints there don't need a re-blur
+     */
+    KWin::Region stableRegion(const KWin::RenderView *view, const KWin::EffectWindow *window) const;
+
+    /**
+     * Drop state e.g. when the view or window was removed
+     */
+    void dropView(const KWin::RenderView *view);
+    void dropWindow(const KWin::EffectWindow *window);
+};
+
+} // namespace BBDX
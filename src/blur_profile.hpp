@@ -0,0 +1,145 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace BBDX {
+
+/**
+ * Quality/update rate adjustments for a single window's blur
+ *
+ * The default constructed profile is full quality
+ * with the globally configured rate limit.
+ */
+struct BlurProfile {
+    // iterations removed from the configured blur strength
+    // (at least one iteration is always kept)
+    size_t iterationReduction{0};
+
+    // pyramid resolution scale
+    qreal resolutionScale{1.0};
+
+    // minimum time between automatic cache flushes
+    // replaces the configured rate limit when set
+    std::optional<std::chrono::milliseconds> rateLimit{};
+
+    // never flush automatically, only on invalidation/explicit flushes
+    bool isStatic{false};
+
+    // render flushes into a back buffer and keep showing
+    // the previous result until the GPU is done with it
+    bool asyncFlush{false};
+
+    bool operator==(const BlurProfile &other) const = default;
+
+    /**
+     * The most restrictive combination of both profiles
+     */
+    BlurProfile combined(const BlurProfile &other) const {
+        BlurProfile result{
+            .iterationReduction = std::max(iterationReduction, other.iterationReduction),
+            .resolutionScale = std::min(resolutionScale, other.resolutionScale),
+            .rateLimit = rateLimit,
+            .isStatic = isStatic || other.isStatic,
+            .asyncFlush = asyncFlush || other.asyncFlush,
+        };
+
+        if (other.rateLimit && (!result.rateLimit || *other.rateLimit > *result.rateLimit)) {
+            result.rateLimit = other.rateLimit;
+        }
+
+        return result;
+    }
+
+    /**
+     * Used while a window is interactively moved/resized
+     */
+    static BlurProfile motion() {
+        return BlurProfile{
+            .iterationReduction = 1,
+            .resolutionScale = 0.5,
+            .rateLimit = std::chrono::milliseconds{50},
+        };
+    }
+
+    /**
+     * Used for windows outside of their output's blur budget
+     * keeps showing the last cached result
+     */
+    static BlurProfile overBudget() {
+        return BlurProfile{
+            .resolutionScale = 0.5,
+            .isStatic = true,
+        };
+    }
+
+    /**
+     * Used while the area behind a window is damaged like a playing video
+     */
+    static BlurProfile videoDamage() {
+        return BlurProfile{
+            .iterationReduction = 1,
+            .resolutionScale = 0.5,
+            .rateLimit = std::chrono::milliseconds{66},
+        };
+    }
+
+    /**
+     * Used for windows hinting a static background
+     * (only refreshed on invalidation)
+     */
+    static BlurProfile staticHint() {
+        return BlurProfile{
+            .isStatic = true,
+        };
+    }
+
+    /**
+     * Used for windows hinting a slowly changing background
+     */
+    static BlurProfile lowRateHint() {
+        return BlurProfile{
+            .rateLimit = std::chrono::milliseconds{100},
+        };
+    }
+
+    /**
+     * Used while the system is saving power
+     */
+    static BlurProfile powerSaving() {
+        return BlurProfile{
+            .iterationReduction = 1,
+            .rateLimit = std::chrono::milliseconds{100},
+        };
+    }
+};
+
+/**
+ * What a BlurProfile amounts to for the configured
+ * blur strength (see BlurEffect::effectiveBlur())
+ */
+struct EffectiveBlur {
+    // downsample/upsample iterations, at least one
+    size_t iterationCount{1};
+
+    // pyramid resolution relative to the background
+    // (profile and dynamic resolution scale)
+    qreal resolutionScale{1.0};
+
+    // sample offset in pyramid pixels
+    float offset{0.0f};
+
+    /**
+     * Radius of the area the kernel samples in logical pixels
+     * each iteration doubles it, lower resolutions stretch it
+     */
+    qreal kernelRadius() const {
+        return qreal(offset) * qreal(size_t{1} << iterationCount) / resolutionScale;
+    }
+};
+
+} // namespace BBDX
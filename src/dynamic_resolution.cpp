@@ -0,0 +1,120 @@
+#include "dynamic_resolution.hpp"
+
+#include "kwin_compat.hpp"
+
+#include "blurconfig.h"
+#include "utils.h"
+
+#include <core/output.h>
+#include <scene/scene.h>
+
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+Q_LOGGING_CATEGORY(DYNAMIC_RESOLUTION, "kwin_effect_better_blur_dx.dynamic_resolution", QtInfoMsg)
+
+// available resolution scales, highest first
+static constexpr std::array<qreal, 5> s_steps{1.0, 0.75, 0.5, 0.375, 0.25};
+
+/**
+ * A frame is overloaded if the blur alone kept the GPU busy for more
+ * than this fraction of the refresh interval, the rest of the scene
+ * has to fit in there as well
+ */
+static constexpr double s_overloadedGPUFraction{0.5};
+static constexpr double s_headroomGPUFraction{0.25};
+
+/**
+ * Hysteresis: step down quickly once frames are missed regularly,
+ * step up only after a few seconds without any trouble
+ */
+static constexpr double s_overloadDecay{0.1};
+static constexpr double s_stepDownOverload{0.3};
+static constexpr int s_stepUpFrames{180};
+
+void BBDX::DynamicResolution::reconfigure() {
+    m_floor = std::clamp(BlurConfig::dynamicResolutionFloor() / 100.0, s_steps.back(), 1.0);
+    m_ceiling = std::clamp(BlurConfig::dynamicResolutionCeiling() / 100.0, m_floor, 1.0);
+
+    m_firstStep = 0;
+    while (m_firstStep < s_steps.size() - 1 && s_steps[m_firstStep] > m_ceiling) {
+        ++m_firstStep;
+    }
+
+    m_lastStep = m_firstStep;
+    while (m_lastStep < s_steps.size() - 1 && s_steps[m_lastStep + 1] >= m_floor) {
+        ++m_lastStep;
+    }
+
+    for (auto &[view, state] : m_views) {
+        state.step = std::clamp(state.step, m_firstStep, m_lastStep);
+    }
+}
+
+void BBDX::DynamicResolution::beginFrame(const KWin::RenderView *view) {
+    auto &state = m_views.try_emplace(view, ViewState{.step = m_firstStep}).first->second;
+    state.gpuTime = std::chrono::microseconds(0);
+}
+
+void BBDX::DynamicResolution::addGPUTime(const KWin::RenderView *view, std::chrono::microseconds gpuTime) {
+    if (auto it = m_views.find(view); it != m_views.end()) {
+        it->second.gpuTime += gpuTime;
+    }
+}
+
+bool BBDX::DynamicResolution::endFrame(const KWin::RenderView *view) {
+    auto it = m_views.find(view);
+    if (it == m_views.end() || m_firstStep == m_lastStep) {
+        return false;
+    }
+    auto &state = it->second;
+
+#if defined(BBDX_X11)
+    const auto refreshInterval = BBDX::outputRefreshInterval(view);
+#else
+    const auto refreshInterval = BBDX::outputRefreshInterval(view->logicalOutput());
+#endif
+
+    // GL calls return long before the GPU is done so CPU paint time says
+    // nothing about the load, neither do frame intervals: content updating
+    // below the refresh rate (e.g. 30 fps video at 60 Hz) looks the same
+    // as missed vblanks
+    const bool overloaded = state.gpuTime > refreshInterval * s_overloadedGPUFraction;
+    const bool headroom = state.gpuTime < refreshInterval * s_headroomGPUFraction;
+
+    state.overload += ((overloaded ? 1.0 : 0.0) - state.overload) * s_overloadDecay;
+    state.headroomFrames = headroom ? state.headroomFrames + 1 : 0;
+
+    const size_t previousStep = state.step;
+    if (state.overload > s_stepDownOverload && state.step < m_lastStep) {
+        ++state.step;
+        state.overload = 0.0;
+        state.headroomFrames = 0;
+    } else if (state.headroomFrames >= s_stepUpFrames && state.step > m_firstStep) {
+        --state.step;
+        state.headroomFrames = 0;
+    }
+
+    if (state.step == previousStep) {
+        return false;
+    }
+
+    qCDebug(DYNAMIC_RESOLUTION) << BBDX::LOG_PREFIX
+                                << "Blur resolution scale changed:" << s_steps[previousStep] << "->" << s_steps[state.step];
+    return true;
+}
+
+qreal BBDX::DynamicResolution::scale(const KWin::RenderView *view) const {
+    if (auto it = m_views.find(view); it != m_views.end()) {
+        return s_steps[std::clamp(it->second.step, m_firstStep, m_lastStep)];
+    }
+
+    return s_steps[m_firstStep];
+}
+
+void BBDX::DynamicResolution::dropView(const KWin::RenderView *view) {
+    m_views.erase(view);
+}
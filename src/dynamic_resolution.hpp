@@ -0,0 +1,88 @@
+#pragma once
+
+#include "kwin_compat.hpp"
+
+#include <QtGlobal>
+
+#include <chrono>
+#include <unordered_map>
+
+namespace KWin {
+#if !defined(BBDX_X11)
+    class RenderView;
+#endif
+}
+
+namespace BBDX {
+
+/**
+ * Dynamic resolution scaling for the blur pyramid
+ *
+ * Watches the GPU time of blur flushes per view (see GPUTimer)
+ * and steps the resolution of the first pyramid level down
+ * when they take up too much of the refresh interval
+ * and back up (with hysteresis) once there is headroom again.
+ *
+ * Without timer query support the resolution stays at the ceiling.
+ */
+class DynamicResolution {
+private:
+    struct ViewState {
+        // GPU time of flushes measured this frame
+        std::chrono::microseconds gpuTime{0};
+
+        // moving average of frames that missed their budget (0..1)
+        double overload{0.0};
+        // consecutive frames with headroom
+        int headroomFrames{0};
+        // index into s_steps
+        size_t step{0};
+    };
+
+    std::unordered_map<const KWin::RenderView *, ViewState> m_views{};
+
+    /**
+     * User settings
+     */
+    qreal m_floor{1.0};
+    qreal m_ceiling{1.0};
+
+    /**
+     * Allowed s_steps index range for m_floor/m_ceiling
+     */
+    size_t m_firstStep{0};
+    size_t m_lastStep{0};
+
+public:
+    /**
+     * reconfigure() hook
+     */
+    void reconfigure();
+
+    /**
+     * Frame timing hooks
+     * from BlurEffect::prePaintScreen() and BlurEffect::postPaintScreen()
+     *
+     * endFrame() returns true if the scale of view changed
+     */
+    void beginFrame(const KWin::RenderView *view);
+    bool endFrame(const KWin::RenderView *view);
+
+    /**
+     * Add GPU time of blur work on view that finished measuring
+     * this frame (see BlurCache::scheduleFlushIntervals())
+     */
+    void addGPUTime(const KWin::RenderView *view, std::chrono::microseconds gpuTime);
+
+    /**
+     * Current pyramid resolution scale for view
+     */
+    qreal scale(const KWin::RenderView *view) const;
+
+    /**
+     * Drop state e.g. when the view was removed
+     */
+    void dropView(const KWin::RenderView *view);
+};
+
+} // namespace BBDX
@@ -0,0 +1,77 @@
+#include "gpu_timer.hpp"
+
+#include <epoxy/gl.h>
+
+#include <chrono>
+#include <memory>
+#include <optional>
+
+bool BBDX::GPUTimer::supported() {
+    if (epoxy_is_desktop_gl()) {
+        return epoxy_gl_version() >= 33 || epoxy_has_gl_extension("GL_ARB_timer_query");
+    }
+
+    return epoxy_has_gl_extension("GL_EXT_disjoint_timer_query");
+}
+
+std::unique_ptr<BBDX::GPUTimer> BBDX::GPUTimer::create() {
+    if (!supported()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<GPUTimer> timer{new GPUTimer()};
+    glGenQueries(s_queryCount, timer->m_queries.data());
+
+    return timer;
+}
+
+BBDX::GPUTimer::~GPUTimer() {
+    glDeleteQueries(s_queryCount, m_queries.data());
+}
+
+void BBDX::GPUTimer::begin() {
+    // all queries still in flight, skip this measurement
+    if (m_active || m_pending[m_next]) {
+        return;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+    m_active = true;
+}
+
+void BBDX::GPUTimer::end() {
+    if (!m_active) {
+        return;
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+    m_active = false;
+    m_pending[m_next] = true;
+    m_next = (m_next + 1) % s_queryCount;
+}
+
+std::optional<std::chrono::microseconds> BBDX::GPUTimer::poll() {
+    std::optional<std::chrono::microseconds> result{};
+
+    // oldest first so the newest result wins
+    for (size_t i = 0; i < s_queryCount; ++i) {
+        const size_t index = (m_next + i) % s_queryCount;
+        if (!m_pending[index]) {
+            continue;
+        }
+
+        GLint available{GL_FALSE};
+        glGetQueryObjectiv(m_queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE) {
+            continue;
+        }
+
+        GLuint64 elapsed{0};
+        glGetQueryObjectui64v(m_queries[index], GL_QUERY_RESULT, &elapsed);
+        m_pending[index] = false;
+
+        result = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds{elapsed});
+    }
+
+    return result;
+}
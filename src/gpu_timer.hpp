@@ -0,0 +1,71 @@
+#pragma once
+
+#include <epoxy/gl.h>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+
+namespace BBDX {
+
+/**
+ * Measures GPU time of a sequence of GL commands
+ * using GL_TIME_ELAPSED timer queries
+ *
+ * Results are read back a few frames later without stalling
+ * so poll() only returns measurements that are already available.
+ *
+ * Owns GL query objects i.e. the OpenGL context
+ * must be current when destroying it.
+ */
+class GPUTimer {
+private:
+    // queries in flight before measurements are skipped
+    static constexpr size_t s_queryCount{3};
+
+    std::array<GLuint, s_queryCount> m_queries{};
+    std::array<bool, s_queryCount> m_pending{};
+    size_t m_next{0};
+    bool m_active{false};
+
+    /**
+     * Use create()
+     */
+    GPUTimer() = default;
+
+public:
+    /**
+     * Whether the current context supports timer queries
+     * (GL 3.3, ARB_timer_query or EXT_disjoint_timer_query)
+     */
+    static bool supported();
+
+    /**
+     * Allocate the query objects
+     * nullptr if timer queries aren't supported
+     */
+    static std::unique_ptr<GPUTimer> create();
+
+    ~GPUTimer();
+
+    /**
+     * Disallow copying GL resources
+     */
+    GPUTimer(GPUTimer &other) = delete;
+    GPUTimer& operator=(GPUTimer &other) = delete;
+
+    /**
+     * Enclose the GL commands to measure
+     * (must not be nested with other GL_TIME_ELAPSED queries)
+     */
+    void begin();
+    void end();
+
+    /**
+     * Newest finished measurement since the last poll()
+     */
+    std::optional<std::chrono::microseconds> poll();
+};
+
+} // namespace BBDX
@@ -132,16 +132,50 @@ void BlurEffectConfig::setupConstraints() {
             case BBDX::BlitMode::WALLPAPER:
                 ui.kcfg_BlurCacheIgnore->setEnabled(false);
                 ui.kcfg_BlurCacheRateLimit->setEnabled(false);
+                ui.kcfg_BlurCacheRefreshDivisor->setEnabled(false);
+                ui.kcfg_BlurCacheMaxStaleness->setEnabled(false);
+                ui.kcfg_BlurCacheFrameBudget->setEnabled(false);
                 break;
 
             default:
                 ui.kcfg_BlurCacheIgnore->setEnabled(true);
                 ui.kcfg_BlurCacheRateLimit->setEnabled(true);
+                ui.kcfg_BlurCacheRefreshDivisor->setEnabled(true);
+                ui.kcfg_BlurCacheMaxStaleness->setEnabled(true);
+                ui.kcfg_BlurCacheFrameBudget->setEnabled(true);
                 break;
         }
     };
     connect(ui.kcfg_BlitMode, &QComboBox::currentIndexChanged, this, slotBlitModeChanged);
     slotBlitModeChanged(ui.kcfg_BlitMode->currentIndex());
+
+    // policy rate limits only apply with policies enabled
+    auto slotBlurCachePoliciesToggled = [this](bool enabled) {
+        ui.kcfg_BlurCachePolicyActiveRateLimit->setEnabled(enabled);
+        ui.kcfg_BlurCachePolicyInactiveRateLimit->setEnabled(enabled);
+        ui.kcfg_BlurCachePolicyInactiveIterationReduction->setEnabled(enabled);
+        ui.kcfg_BlurCachePolicyInactiveResolution->setEnabled(enabled);
+        ui.kcfg_BlurCachePolicyMenuRateLimit->setEnabled(enabled);
+        ui.kcfg_BlurCachePolicyDockRateLimit->setEnabled(enabled);
+        ui.kcfg_BlurCachePolicyNotificationRateLimit->setEnabled(enabled);
+    };
+    connect(ui.kcfg_BlurCachePolicies, &QCheckBox::toggled, this, slotBlurCachePoliciesToggled);
+    slotBlurCachePoliciesToggled(ui.kcfg_BlurCachePolicies->isChecked());
+
+    // the area threshold only exempts windows from a limited budget
+    auto slotBlurBudgetWindowsChanged = [this](int windows) {
+        ui.kcfg_BlurBudgetAreaThreshold->setEnabled(windows > 0);
+    };
+    connect(ui.kcfg_BlurBudgetWindows, &QSpinBox::valueChanged, this, slotBlurBudgetWindowsChanged);
+    slotBlurBudgetWindowsChanged(ui.kcfg_BlurBudgetWindows->value());
+
+    // without the cache every frame flushes in one go anyways
+    auto slotBlurCacheIgnoreToggled = [this](bool ignore) {
+        ui.kcfg_AsyncFlushMode->setEnabled(!ignore);
+        ui.kcfg_BlurCacheProgressivePasses->setEnabled(!ignore);
+    };
+    connect(ui.kcfg_BlurCacheIgnore, &QCheckBox::toggled, this, slotBlurCacheIgnoreToggled);
+    slotBlurCacheIgnoreToggled(ui.kcfg_BlurCacheIgnore->isChecked());
 }
 
 void BlurEffectConfig::slotRefractionModeChanged(int index) {
@@ -0,0 +1,146 @@
+#include "memory_pressure_monitor.hpp"
+
+#include "blurconfig.h"
+#include "utils.h"
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QString>
+
+#include <chrono>
+
+Q_LOGGING_CATEGORY(MEMORY_PRESSURE, "kwin_effect_better_blur_dx.memory_pressure", QtInfoMsg)
+
+/**
+ * PSI avg10 thresholds (percentage of time stalled on memory)
+ *
+ * A level is entered above its threshold and only left
+ * once pressure dropped below half of it
+ */
+static constexpr double s_moderateSome{10.0};
+static constexpr double s_criticalSome{40.0};
+static constexpr double s_criticalFull{10.0};
+static constexpr double s_hysteresis{0.5};
+
+static constexpr std::chrono::milliseconds s_pollInterval{2000};
+
+std::unique_ptr<BBDX::MemoryPressureMonitor> BBDX::MemoryPressureMonitor::create() {
+    std::unique_ptr<MemoryPressureMonitor> monitor{new MemoryPressureMonitor()};
+
+    monitor->m_pollTimer.setInterval(s_pollInterval);
+    connect(&monitor->m_pollTimer, &QTimer::timeout, monitor.get(), &MemoryPressureMonitor::slotPoll);
+
+    return monitor;
+}
+
+void BBDX::MemoryPressureMonitor::reconfigure() {
+    m_source = BlurConfig::memoryPressureSource();
+
+    if (m_source.isEmpty()) {
+        m_pollTimer.stop();
+        if (m_level != Level::None) {
+            m_level = Level::None;
+            Q_EMIT levelChanged(m_level);
+        }
+        return;
+    }
+
+    if (!m_pollTimer.isActive()) {
+        m_pollTimer.start();
+    }
+}
+
+std::optional<BBDX::MemoryPressureMonitor::Pressure> BBDX::MemoryPressureMonitor::readPressure(const QString &source) {
+    QFile file{source};
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return std::nullopt;
+    }
+
+    // format (PSI):
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    // full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    std::optional<Pressure> pressure{};
+    const auto lines = QString::fromUtf8(file.readAll()).split('\n', Qt::SkipEmptyParts);
+    for (const auto &line : lines) {
+        const auto fields = line.split(' ', Qt::SkipEmptyParts);
+        if (fields.size() < 2 || !fields[1].startsWith(QLatin1String("avg10="))) {
+            continue;
+        }
+
+        bool ok{false};
+        const double avg10 = fields[1].mid(6).toDouble(&ok);
+        if (!ok) {
+            continue;
+        }
+
+        if (!pressure) {
+            pressure = Pressure{};
+        }
+
+        if (fields[0] == QLatin1String("some")) {
+            pressure->some = avg10;
+        } else if (fields[0] == QLatin1String("full")) {
+            pressure->full = avg10;
+        }
+    }
+
+    return pressure;
+}
+
+BBDX::MemoryPressureMonitor::Level BBDX::MemoryPressureMonitor::levelFor(Level current, const Pressure &pressure) {
+    const auto critical = [&pressure](double factor) {
+        return pressure.some >= s_criticalSome * factor || pressure.full >= s_criticalFull * factor;
+    };
+    const auto moderate = [&pressure](double factor) {
+        return pressure.some >= s_moderateSome * factor;
+    };
+
+    switch (current) {
+        case Level::Critical:
+            if (critical(s_hysteresis)) {
+                return Level::Critical;
+            }
+            return moderate(s_hysteresis) ? Level::Moderate : Level::None;
+
+        case Level::Moderate:
+            if (critical(1.0)) {
+                return Level::Critical;
+            }
+            return moderate(s_hysteresis) ? Level::Moderate : Level::None;
+
+        case Level::None:
+        default:
+            if (critical(1.0)) {
+                return Level::Critical;
+            }
+            return moderate(1.0) ? Level::Moderate : Level::None;
+    }
+}
+
+void BBDX::MemoryPressureMonitor::slotPoll() {
+    const auto pressure = readPressure(m_source);
+    if (!pressure) {
+        qCWarning(MEMORY_PRESSURE) << BBDX::LOG_PREFIX << "Failed to read memory pressure from" << m_source << "\n"
+                                   << "Disabling memory pressure monitoring";
+        m_pollTimer.stop();
+        // nothing would ever lift the current level
+        if (m_level != Level::None) {
+            m_level = Level::None;
+            Q_EMIT levelChanged(m_level);
+        }
+        return;
+    }
+
+    const Level level = levelFor(m_level, *pressure);
+    if (level == m_level) {
+        return;
+    }
+
+    qCDebug(MEMORY_PRESSURE) << BBDX::LOG_PREFIX
+                             << "Memory pressure changed:" << m_level << "->" << level << "\n"
+                             << "some avg10:" << pressure->some << "\n"
+                             << "full avg10:" << pressure->full;
+
+    m_level = level;
+    Q_EMIT levelChanged(m_level);
+}
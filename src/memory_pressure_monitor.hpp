@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <chrono>
+#include <memory>
+#include <optional>
+
+namespace BBDX {
+
+/**
+ * Polls a Linux PSI file (/proc/pressure/memory or a cgroup's memory.pressure)
+ * and reports coarse memory pressure levels
+ *
+ * On iGPUs texture memory is system memory so blur caches
+ * directly compete with applications under pressure.
+ */
+class MemoryPressureMonitor : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Level {
+        None,
+        Moderate,
+        Critical,
+    };
+    Q_ENUM(Level)
+
+private:
+    // PSI file to read, polling is stopped if this is empty
+    QString m_source{};
+
+    QTimer m_pollTimer{};
+    Level m_level{Level::None};
+
+    /**
+     * Use create()
+     */
+    MemoryPressureMonitor() = default;
+
+private Q_SLOTS:
+    void slotPoll();
+
+Q_SIGNALS:
+    void levelChanged(BBDX::MemoryPressureMonitor::Level level);
+
+public:
+    static std::unique_ptr<MemoryPressureMonitor> create();
+
+    /**
+     * Read "some" and "full" avg10 values from a PSI file
+     *
+     * std::nullopt if the file can't be read or parsed
+     */
+    struct Pressure {
+        double some{0.0};
+        double full{0.0};
+    };
+    static std::optional<Pressure> readPressure(const QString &source);
+
+    /**
+     * Map pressure to a level
+     * with hysteresis relative to the current level
+     */
+    static Level levelFor(Level current, const Pressure &pressure);
+
+    /**
+     * reconfigure() hook
+     */
+    void reconfigure();
+
+    /**
+     * Getters
+     */
+    Level level() const { return m_level; }
+};
+
+} // namespace BBDX
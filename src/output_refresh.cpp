@@ -0,0 +1,94 @@
+#include "output_refresh.hpp"
+
+#include "kwin_compat.hpp"
+
+#include "blurconfig.h"
+#include "utils.h"
+
+#include <core/output.h>
+#include <scene/scene.h>
+
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <chrono>
+
+Q_LOGGING_CATEGORY(OUTPUT_REFRESH, "kwin_effect_better_blur_dx.output_refresh", QtInfoMsg)
+
+/**
+ * Frame intervals longer than this are idle gaps
+ * rather than a low VRR refresh rate
+ */
+static constexpr std::chrono::microseconds s_idleFrameInterval{50'000};
+
+// weight of a new sample in the measured interval
+static constexpr double s_measuredIntervalWeight{0.1};
+
+static const KWin::LogicalOutput *viewOutput(const KWin::RenderView *view) {
+#if defined(BBDX_X11)
+    return view;
+#else
+    return view->logicalOutput();
+#endif
+}
+
+void BBDX::OutputRefresh::reconfigure() {
+    m_divisor = std::max(0, BlurConfig::blurCacheRefreshDivisor());
+}
+
+void BBDX::OutputRefresh::beginFrame(const KWin::RenderView *view) {
+    auto &state = m_views[view];
+
+    const auto output = viewOutput(view);
+    const auto refreshInterval = BBDX::outputRefreshInterval(output);
+    const bool vrr = BBDX::outputVrrActive(output);
+
+    // start measuring from scratch when the mode changed
+    if (refreshInterval != state.refreshInterval || vrr != state.vrr) {
+        qCDebug(OUTPUT_REFRESH) << BBDX::LOG_PREFIX
+                                << "Refresh of view changed:" << state.refreshInterval.count() << "->" << refreshInterval.count() << "us"
+                                << "VRR:" << vrr;
+        state.refreshInterval = refreshInterval;
+        state.vrr = vrr;
+        state.measuredInterval = refreshInterval;
+        state.lastFrameStart = {};
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (state.vrr && state.lastFrameStart != std::chrono::steady_clock::time_point{}) {
+        const auto frameInterval = std::chrono::duration_cast<std::chrono::microseconds>(now - state.lastFrameStart);
+        if (frameInterval < s_idleFrameInterval) {
+            const double measured = static_cast<double>(state.measuredInterval.count());
+            state.measuredInterval = std::chrono::microseconds{static_cast<int64_t>(
+                measured + (static_cast<double>(frameInterval.count()) - measured) * s_measuredIntervalWeight)};
+        }
+    }
+    state.lastFrameStart = now;
+}
+
+std::chrono::microseconds BBDX::OutputRefresh::refreshInterval(const KWin::RenderView *view) const {
+    auto it = m_views.find(view);
+    if (it == m_views.end()) {
+        return BBDX::outputRefreshInterval(viewOutput(view));
+    }
+
+    const auto &state = it->second;
+    if (state.vrr) {
+        // VRR never refreshes faster than the nominal rate
+        return std::max(state.refreshInterval, state.measuredInterval);
+    }
+
+    return state.refreshInterval;
+}
+
+std::optional<std::chrono::microseconds> BBDX::OutputRefresh::rateLimit(const KWin::RenderView *view) const {
+    if (m_divisor <= 0) {
+        return std::nullopt;
+    }
+
+    return refreshInterval(view) * m_divisor;
+}
+
+void BBDX::OutputRefresh::dropView(const KWin::RenderView *view) {
+    m_views.erase(view);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "kwin_compat.hpp"
+
+#include <chrono>
+#include <optional>
+#include <unordered_map>
+
+namespace KWin {
+#if !defined(BBDX_X11)
+    class RenderView;
+#endif
+}
+
+namespace BBDX {
+
+/**
+ * Per view refresh tracking for the blur cache rate limit
+ *
+ * Follows each view's refresh rate and VRR state so the cache
+ * can be flushed every n-th frame instead of at a fixed interval.
+ * With VRR the measured frame interval is used since the
+ * nominal refresh rate is only an upper bound.
+ */
+class OutputRefresh {
+private:
+    struct ViewState {
+        std::chrono::microseconds refreshInterval{0};
+        bool vrr{false};
+
+        std::chrono::steady_clock::time_point lastFrameStart{};
+        // moving average of non-idle frame intervals
+        std::chrono::microseconds measuredInterval{0};
+    };
+
+    std::unordered_map<const KWin::RenderView *, ViewState> m_views{};
+
+    /**
+     * User settings
+     * flush every m_divisor frames, 0 uses the fixed rate limit
+     */
+    int m_divisor{0};
+
+public:
+    /**
+     * reconfigure() hook
+     */
+    void reconfigure();
+
+    /**
+     * Frame timing hook from BlurEffect::prePaintScreen()
+     */
+    void beginFrame(const KWin::RenderView *view);
+
+    /**
+     * Effective refresh interval of view
+     * (measured under VRR)
+     */
+    std::chrono::microseconds refreshInterval(const KWin::RenderView *view) const;
+
+    /**
+     * Cache rate limit for view
+     * std::nullopt if the fixed rate limit should be used
+     */
+    std::optional<std::chrono::microseconds> rateLimit(const KWin::RenderView *view) const;
+
+    /**
+     * Drop state e.g. when the view was removed
+     */
+    void dropView(const KWin::RenderView *view);
+};
+
+} // namespace BBDX
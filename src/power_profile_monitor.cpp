@@ -0,0 +1,171 @@
+#include "power_profile_monitor.hpp"
+
+#include "blurconfig.h"
+#include "utils.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(POWER_PROFILE, "kwin_effect_better_blur_dx.power_profile", QtInfoMsg)
+
+/**
+ * power-profiles-daemon still provides its original name
+ * next to org.freedesktop.UPower.PowerProfiles
+ */
+static const QString s_powerProfilesService{QStringLiteral("net.hadess.PowerProfiles")};
+static const QString s_powerProfilesPath{QStringLiteral("/net/hadess/PowerProfiles")};
+static const QString s_powerProfilesInterface{QStringLiteral("net.hadess.PowerProfiles")};
+static const QString s_powerSaverProfile{QStringLiteral("power-saver")};
+
+static const QString s_upowerService{QStringLiteral("org.freedesktop.UPower")};
+static const QString s_upowerPath{QStringLiteral("/org/freedesktop/UPower")};
+static const QString s_upowerInterface{QStringLiteral("org.freedesktop.UPower")};
+
+static const QString s_propertiesInterface{QStringLiteral("org.freedesktop.DBus.Properties")};
+
+std::unique_ptr<BBDX::PowerProfileMonitor> BBDX::PowerProfileMonitor::create(const QDBusConnection &bus) {
+    std::unique_ptr<PowerProfileMonitor> monitor{new PowerProfileMonitor()};
+    monitor->m_bus = bus;
+
+    if (!bus.isConnected()) {
+        qCWarning(POWER_PROFILE) << BBDX::LOG_PREFIX << "No D-Bus connection, power profile support disabled";
+        return monitor;
+    }
+
+    monitor->m_bus.connect(s_powerProfilesService, s_powerProfilesPath, s_propertiesInterface, QStringLiteral("PropertiesChanged"),
+                           monitor.get(), SLOT(slotPowerProfilesChanged(QString, QVariantMap, QStringList)));
+    monitor->m_bus.connect(s_upowerService, s_upowerPath, s_propertiesInterface, QStringLiteral("PropertiesChanged"),
+                           monitor.get(), SLOT(slotUPowerChanged(QString, QVariantMap, QStringList)));
+
+    // daemons may (re)start after us
+    monitor->m_serviceWatcher.setConnection(monitor->m_bus);
+    monitor->m_serviceWatcher.setWatchMode(QDBusServiceWatcher::WatchForRegistration | QDBusServiceWatcher::WatchForUnregistration);
+    monitor->m_serviceWatcher.addWatchedService(s_powerProfilesService);
+    monitor->m_serviceWatcher.addWatchedService(s_upowerService);
+    connect(&monitor->m_serviceWatcher, &QDBusServiceWatcher::serviceRegistered, monitor.get(), &PowerProfileMonitor::slotServiceRegistered);
+    connect(&monitor->m_serviceWatcher, &QDBusServiceWatcher::serviceUnregistered, monitor.get(), &PowerProfileMonitor::slotServiceUnregistered);
+
+    monitor->fetchActiveProfile();
+    monitor->fetchOnBattery();
+
+    return monitor;
+}
+
+void BBDX::PowerProfileMonitor::reconfigure() {
+    m_mode = static_cast<PowerSavingMode>(BlurConfig::powerSavingMode());
+
+    // called from BlurEffect::reconfigure() which
+    // applies the new state anyway, no need to notify
+    m_powerSaving = shouldSavePower();
+}
+
+void BBDX::PowerProfileMonitor::fetchActiveProfile() {
+    auto message = QDBusMessage::createMethodCall(s_powerProfilesService, s_powerProfilesPath, s_propertiesInterface, QStringLiteral("Get"));
+    message << s_powerProfilesInterface << QStringLiteral("ActiveProfile");
+
+    auto watcher = new QDBusPendingCallWatcher(m_bus.asyncCall(message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *watcher) {
+        QDBusPendingReply<QDBusVariant> reply = *watcher;
+        watcher->deleteLater();
+
+        // no daemon means no power saver profile
+        if (reply.isError()) {
+            return;
+        }
+
+        m_activeProfile = reply.value().variant().toString();
+        update();
+    });
+}
+
+void BBDX::PowerProfileMonitor::fetchOnBattery() {
+    auto message = QDBusMessage::createMethodCall(s_upowerService, s_upowerPath, s_propertiesInterface, QStringLiteral("Get"));
+    message << s_upowerInterface << QStringLiteral("OnBattery");
+
+    auto watcher = new QDBusPendingCallWatcher(m_bus.asyncCall(message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *watcher) {
+        QDBusPendingReply<QDBusVariant> reply = *watcher;
+        watcher->deleteLater();
+
+        if (reply.isError()) {
+            return;
+        }
+
+        m_onBattery = reply.value().variant().toBool();
+        update();
+    });
+}
+
+bool BBDX::PowerProfileMonitor::shouldSavePower() const {
+    switch (m_mode) {
+        case PowerSavingMode::POWER_SAVING_POWER_SAVER_OR_BATTERY:
+            return m_onBattery || m_activeProfile == s_powerSaverProfile;
+
+        case PowerSavingMode::POWER_SAVING_POWER_SAVER:
+            return m_activeProfile == s_powerSaverProfile;
+
+        case PowerSavingMode::POWER_SAVING_NEVER:
+        default:
+            return false;
+    }
+}
+
+void BBDX::PowerProfileMonitor::update() {
+    const bool powerSaving = shouldSavePower();
+    if (powerSaving == m_powerSaving) {
+        return;
+    }
+
+    qCDebug(POWER_PROFILE) << BBDX::LOG_PREFIX
+                           << "Power saving changed:" << m_powerSaving << "->" << powerSaving << "\n"
+                           << "profile:" << m_activeProfile << "\n"
+                           << "on battery:" << m_onBattery;
+
+    m_powerSaving = powerSaving;
+    Q_EMIT powerSavingChanged(m_powerSaving);
+}
+
+void BBDX::PowerProfileMonitor::slotPowerProfilesChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated) {
+    Q_UNUSED(invalidated);
+    if (interface != s_powerProfilesInterface) {
+        return;
+    }
+
+    if (auto it = changed.find(QStringLiteral("ActiveProfile")); it != changed.end()) {
+        m_activeProfile = it->toString();
+        update();
+    }
+}
+
+void BBDX::PowerProfileMonitor::slotUPowerChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated) {
+    Q_UNUSED(invalidated);
+    if (interface != s_upowerInterface) {
+        return;
+    }
+
+    if (auto it = changed.find(QStringLiteral("OnBattery")); it != changed.end()) {
+        m_onBattery = it->toBool();
+        update();
+    }
+}
+
+void BBDX::PowerProfileMonitor::slotServiceRegistered(const QString &service) {
+    if (service == s_powerProfilesService) {
+        fetchActiveProfile();
+    } else if (service == s_upowerService) {
+        fetchOnBattery();
+    }
+}
+
+void BBDX::PowerProfileMonitor::slotServiceUnregistered(const QString &service) {
+    if (service == s_powerProfilesService) {
+        m_activeProfile.clear();
+    } else if (service == s_upowerService) {
+        m_onBattery = false;
+    }
+    update();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "settings.hpp"
+
+#include <QDBusConnection>
+#include <QDBusServiceWatcher>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <memory>
+
+namespace BBDX {
+
+/**
+ * Follows the system power profile (power-profiles-daemon)
+ * and battery state (UPower) over the system D-Bus
+ *
+ * Reports whether blur should currently save power
+ * according to the configured PowerSavingMode.
+ */
+class PowerProfileMonitor : public QObject {
+    Q_OBJECT
+
+private:
+    QDBusConnection m_bus{QString()};
+    QDBusServiceWatcher m_serviceWatcher{};
+
+    // last known daemon state
+    QString m_activeProfile{};
+    bool m_onBattery{false};
+
+    /**
+     * User settings
+     */
+    PowerSavingMode m_mode{PowerSavingMode::POWER_SAVING_NEVER};
+
+    bool m_powerSaving{false};
+
+    /**
+     * Use create()
+     */
+    PowerProfileMonitor() = default;
+
+    /**
+     * Asynchronously fetch the current
+     * profile/battery state from the daemons
+     */
+    void fetchActiveProfile();
+    void fetchOnBattery();
+
+    /**
+     * Whether the daemon state and
+     * m_mode call for power saving
+     */
+    bool shouldSavePower() const;
+
+    /**
+     * Re-evaluate m_powerSaving
+     * and emit powerSavingChanged() if needed
+     */
+    void update();
+
+private Q_SLOTS:
+    void slotPowerProfilesChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated);
+    void slotUPowerChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated);
+    void slotServiceRegistered(const QString &service);
+    void slotServiceUnregistered(const QString &service);
+
+Q_SIGNALS:
+    void powerSavingChanged(bool powerSaving);
+
+public:
+    /**
+     * Watch the daemons on bus
+     * (the system bus, tests pass a bus with mock services)
+     */
+    static std::unique_ptr<PowerProfileMonitor> create(const QDBusConnection &bus = QDBusConnection::systemBus());
+
+    /**
+     * reconfigure() hook
+     */
+    void reconfigure();
+
+    /**
+     * Getters
+     */
+    bool powerSaving() const { return m_powerSaving; }
+};
+
+} // namespace BBDX
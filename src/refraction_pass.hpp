@@ -31,6 +31,9 @@ private:
 
     bool m_enabled{false};
 
+    // temporarily disabled e.g. while saving power
+    bool m_suspended{false};
+
     // user settings
     qreal m_normalPow{};
     qreal m_strength{};
@@ -56,7 +59,13 @@ public:
     /**
      * Check if refraction pass is enabled
      */
-    bool enabled() const { return m_enabled; }
+    bool enabled() const { return m_enabled && !m_suspended; }
+
+    /**
+     * Temporarily disable the pass
+     * without touching the user settings
+     */
+    void setSuspended(bool suspended) { m_suspended = suspended; }
 
     /**
      * Push respective shader to the ShaderManager
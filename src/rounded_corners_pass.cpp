@@ -60,12 +60,12 @@ void BBDX::RoundedCornersPass::apply(const WindowManager *windowManager,
             // without rounded corners swizzle alpha
             // channel to 1.0 for future reads
             // as it may contain garbage otherwise (bad blit or whatever)
-            cacheEntry->cachedTexture()->setSwizzle(GL_RED, GL_GREEN, GL_BLUE, GL_ONE);
+            cacheEntry->flushTexture()->setSwizzle(GL_RED, GL_GREEN, GL_BLUE, GL_ONE);
             return;
         }
         
         // with rounded corners the shader will properly override the alpha channel
-        cacheEntry->cachedTexture()->setSwizzle(GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA);
+        cacheEntry->flushTexture()->setSwizzle(GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA);
 
         KWin::ShaderManager::instance()->pushShader(m_shader.get());
 
@@ -77,7 +77,7 @@ void BBDX::RoundedCornersPass::apply(const WindowManager *windowManager,
         projectionMatrix.ortho(QRectF(0.0, 0.0, backgroundRect.width(), backgroundRect.height()));
 
         // we want to mask the corners of what is already cached
-        const auto &read = cacheEntry->cachedFramebuffer();
+        const auto &read = cacheEntry->flushFramebuffer();
 
         const KWin::RectF transformedRect = KWin::RectF{
             w->frameGeometry().x() + data.xTranslation() / data.xScale(),
@@ -22,4 +22,41 @@ enum BlitMode {
     WALLPAPER,
 };
 
+/**
+ * When to reduce blur quality
+ * to save power
+ *
+ * (prefixed, unscoped enums share the BBDX namespace
+ * and kconfig_compiler needs them to convert to int)
+ */
+enum PowerSavingMode {
+    // always use the configured quality
+    POWER_SAVING_NEVER,
+
+    // while the power-saver profile is active
+    POWER_SAVING_POWER_SAVER,
+
+    // additionally while running on battery
+    POWER_SAVING_POWER_SAVER_OR_BATTERY,
+};
+
+/**
+ * Which windows flush their cache
+ * asynchronously (showing the previous
+ * result until the GPU finished the new one)
+ *
+ * (prefixed like PowerSavingMode)
+ */
+enum AsyncFlushMode {
+    // always wait for the flush
+    // i.e. never show an outdated blur
+    ASYNC_FLUSH_OFF,
+
+    // everything but the active window and menus
+    ASYNC_FLUSH_BACKGROUND,
+
+    // all windows
+    ASYNC_FLUSH_ALWAYS,
+};
+
 }
@@ -2,6 +2,8 @@
 
 #include "kwin_compat.hpp"
 
+#include <core/output.h>
+#include <core/renderloop.h>
 #include <opengl/gltexture.h>
 #include <opengl/glframebuffer.h>
 
@@ -58,6 +60,56 @@ void BBDX::setGLScissor(const KWin::Region &dirtyRegion, const KWin::Rect &backg
     glScissor(glX, glY, glWidth, glHeight);
 }
 
+void BBDX::drawGLScissored(const KWin::Region &dirtyRegion,
+                           const KWin::Rect &backgroundRect,
+                           const std::function<void()> &draw) {
+    // each scissored draw re-issues the whole quad,
+    // past this many the savings are eaten up by draw overhead
+    static constexpr qsizetype maxScissorRects{16};
+
+    const auto fbo = KWin::GLFramebuffer::currentFramebuffer();
+    if (!fbo) {
+        qCWarning(BBDX_UTILS) << "BBDX::drawGLScissored() called with no GLFramebuffer attached";
+        return;
+    }
+
+    const auto texture = fbo->colorAttachment();
+
+    const double scaleX{static_cast<double>(texture->width()) / static_cast<double>(backgroundRect.width())};
+    const double scaleY{static_cast<double>(texture->height()) / static_cast<double>(backgroundRect.height())};
+
+    // same expansion as setGLScissor(), merged before
+    // scaling so neighbouring bands don't overlap
+    KWin::Region expanded;
+    for (const KWin::Rect &rect : dirtyRegion.translated(-backgroundRect.topLeft()).rects()) {
+        expanded += rect.adjusted(-8, -8, 8, 8);
+    }
+
+    // rounding outwards can still make scaled boxes overlap,
+    // merge again in texel space
+    const KWin::Rect textureRect{0, 0, texture->width(), texture->height()};
+    KWin::Region boxes;
+    for (const KWin::Rect &rect : expanded.rects()) {
+        const int left{static_cast<int>(std::floor(rect.x() * scaleX))};
+        const int top{static_cast<int>(std::floor(rect.y() * scaleY))};
+        const int right{static_cast<int>(std::ceil((rect.x() + rect.width()) * scaleX))};
+        const int bottom{static_cast<int>(std::ceil((rect.y() + rect.height()) * scaleY))};
+        boxes += KWin::Rect(left, top, right - left, bottom - top).intersected(textureRect);
+    }
+
+    if (boxes.rects().size() > maxScissorRects) {
+        setGLScissor(dirtyRegion, backgroundRect);
+        draw();
+        return;
+    }
+
+    glEnable(GL_SCISSOR_TEST);
+    for (const KWin::Rect &box : boxes.rects()) {
+        glScissor(box.x(), texture->height() - (box.y() + box.height()), box.width(), box.height());
+        draw();
+    }
+}
+
 void BBDX::clearGLScissor() {
     glScissor(0, 0, 0, 0);
     glDisable(GL_SCISSOR_TEST);
@@ -100,3 +152,55 @@ KWin::RegionF BBDX::regionTranslatedF(KWin::RegionF region, QPointF translation)
     return region.translated(translation);
 #endif
 }
+
+bool BBDX::outputIsPoweredOn(const KWin::LogicalOutput *output) {
+#if KWIN_VERSION < KWIN_VERSION_CODE(6, 5, 80)
+    return output->dpmsMode() == KWin::Output::DpmsMode::On;
+#else
+    return output->backendOutput()->dpmsMode() == KWin::BackendOutput::DpmsMode::On;
+#endif
+}
+
+QMetaObject::Connection BBDX::connectOutputDpmsChanged(const KWin::LogicalOutput *output, QObject *context, std::function<void()> slot) {
+#if KWIN_VERSION < KWIN_VERSION_CODE(6, 5, 80)
+    return QObject::connect(output, &KWin::Output::dpmsModeChanged, context, std::move(slot));
+#else
+    return QObject::connect(output->backendOutput(), &KWin::BackendOutput::dpmsModeChanged, context, std::move(slot));
+#endif
+}
+
+std::chrono::microseconds BBDX::outputRefreshInterval(const KWin::LogicalOutput *output) {
+#if KWIN_VERSION < KWIN_VERSION_CODE(6, 5, 80)
+    const int refreshRate = output ? output->refreshRate() : 0;
+#else
+    const int refreshRate = output ? output->backendOutput()->refreshRate() : 0;
+#endif
+
+    // refreshRate is in mHz
+    if (refreshRate <= 0) {
+        return std::chrono::microseconds{16667};
+    }
+
+    return std::chrono::microseconds{1'000'000'000 / refreshRate};
+}
+
+bool BBDX::outputVrrActive(const KWin::LogicalOutput *output) {
+    if (!output) {
+        return false;
+    }
+
+    // the default policy (Automatic) only engages adaptive sync
+    // for fullscreen content, the desktop runs at the fixed rate
+#if KWIN_VERSION < KWIN_VERSION_CODE(6, 5, 80)
+    const KWin::RenderLoop *renderLoop = output->renderLoop();
+#else
+    const KWin::RenderLoop *renderLoop = output->backendOutput()->renderLoop();
+#endif
+    if (!renderLoop) {
+        return false;
+    }
+
+    const KWin::PresentationMode mode = renderLoop->presentationMode();
+    return mode == KWin::PresentationMode::AdaptiveSync
+           || mode == KWin::PresentationMode::AdaptiveAsync;
+}
@@ -7,9 +7,19 @@
 
 #include <epoxy/gl.h>
 
+#include <QMetaObject>
 #include <QSize>
 #include <QString>
 
+#include <chrono>
+#include <functional>
+
+#if KWIN_VERSION >= KWIN_VERSION_CODE(6, 5, 80)
+namespace KWin {
+    class LogicalOutput;
+}
+#endif
+
 namespace BBDX
 {
 
@@ -34,6 +44,21 @@ QSize getTextureSize(const QRect &backgroundRect, const size_t i);
  */
 void setGLScissor(const KWin::Region &dirtyRegion, const KWin::Rect &backgroundRect);
 
+/**
+ * Run draw once per rect of dirtyRegion, each scissored
+ * like setGLScissor() would scissor that rect alone
+ *
+ * The scissor boxes are disjoint so blended passes never touch
+ * a pixel twice, a region split into too many rects is drawn once
+ * with the scissor of its bounding rect instead
+ *
+ * implicitly targets the current attached framebuffer and
+ * thus must be called after GLFramebuffer::pushFramebuffer()
+ */
+void drawGLScissored(const KWin::Region &dirtyRegion,
+                     const KWin::Rect &backgroundRect,
+                     const std::function<void()> &draw);
+
 /**
  * Cleanup for setGLScissor
  *
@@ -64,4 +89,26 @@ KWin::Rect rectRoundedOut(KWin::RectF rect);
  */
 KWin::RegionF regionTranslatedF(KWin::RegionF region, QPointF translation);
 
+/**
+ * Version agnostic check whether an output is powered on (DPMS)
+ */
+bool outputIsPoweredOn(const KWin::LogicalOutput *output);
+
+/**
+ * Version agnostic connection to an output's DPMS mode changes
+ */
+QMetaObject::Connection connectOutputDpmsChanged(const KWin::LogicalOutput *output, QObject *context, std::function<void()> slot);
+
+/**
+ * Version agnostic duration of one refresh cycle of an output
+ * (60Hz if the output doesn't report a refresh rate)
+ */
+std::chrono::microseconds outputRefreshInterval(const KWin::LogicalOutput *output);
+
+/**
+ * Version agnostic check whether an output
+ * currently presents with adaptive sync engaged
+ */
+bool outputVrrActive(const KWin::LogicalOutput *output);
+
 }
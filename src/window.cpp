@@ -38,9 +38,11 @@ BBDX::Window::Window(BBDX::WindowManager *wm, KWin::EffectWindow *w) {
     connect(w, &KWin::EffectWindow::windowStartUserMovedResized, this, &BBDX::Window::slotWindowStartUserMovedResized);
     connect(w, &KWin::EffectWindow::windowFinishUserMovedResized, this, &BBDX::Window::slotWindowFinishUserMovedResized);
     connect(w, &KWin::EffectWindow::windowOpacityChanged, this, &BBDX::Window::slotWindowOpacityChanged);
+    connect(w->window(), &KWin::Window::damaged, this, &BBDX::Window::slotWindowDamaged);
 }
 
 void BBDX::Window::slotMinimizedChanged() {
+    m_windowManager->invalidateBlurCoverage();
     refreshMaximizedState();
     if (m_maximizedState == MaximizedState::Complete
         && m_isMinimized) {
@@ -51,10 +53,13 @@ void BBDX::Window::slotMinimizedChanged() {
 void BBDX::Window::slotWindowFullScreenChanged() {
     // windowFrameGeometryChanged occurs before this
     // so we need to catch it explicitly to update our tracker
+    m_windowManager->invalidateBlurCoverage();
     refreshMaximizedState();
 }
 
 void BBDX::Window::slotWindowStartUserMovedResized() {
+    m_isUserMovedResized = true;
+
     if (blurOriginIs(BlurOrigin::ForcedContent)) {
         // Don't allow blurring while transformed during move/resize
         // to avoid dragging an off-looking rectangular blur region
@@ -69,6 +74,12 @@ void BBDX::Window::slotWindowStartUserMovedResized() {
 }
 
 void BBDX::Window::slotWindowFinishUserMovedResized() {
+    // back to full quality with a single refinement flush
+    m_isUserMovedResized = false;
+    m_windowManager->invalidateBlurCache(m_effectwindow,
+                                         static_cast<uint>(BlurCacheInvalidationFlag::REGION),
+                                         "Finished move/resize");
+
     if (blurOriginIs(BlurOrigin::ForcedContent)) {
         // After move/resize force blurring while transformed.
         // While still suboptimal (the Wobbly Windows effect doesn't end
@@ -84,15 +95,27 @@ void BBDX::Window::slotWindowFinishUserMovedResized() {
 }
 
 void BBDX::Window::slotWindowFrameGeometryChanged() {
+    m_windowManager->invalidateBlurCoverage();
     updateForceBlurRegion();
     refreshMaximizedState();
 
+    // pure moves keep their cache, BlurCache::preparePaintData()
+    // shifts its content and only re-blurs the newly exposed parts
+    const QSize frameSize = m_effectwindow->frameGeometry().toRect().size();
+    const bool moved = frameSize == m_frameSize;
+    m_frameSize = frameSize;
+
     // Just mark cache region dirty to force a full flush here.
     // BlurEffect::blur() may upgrade this to realloc buffers
     // in case their size doesn't match anymore
-    m_windowManager->invalidateBlurCache(m_effectwindow,
-                                         static_cast<uint>(BlurCacheInvalidationFlag::REGION),
-                                         "frameGeometry changed");
+    //
+    // While being dragged the motion profile's rate limit applies instead
+    // (size changes still realloc), slotWindowFinishUserMovedResized() refines
+    if (!m_isUserMovedResized && !moved) {
+        m_windowManager->invalidateBlurCache(m_effectwindow,
+                                             static_cast<uint>(BlurCacheInvalidationFlag::REGION),
+                                             "frameGeometry changed");
+    }
 
     // Not sure if this is the best place to unset
     // this but seems to work fine for now
@@ -101,6 +124,7 @@ void BBDX::Window::slotWindowFrameGeometryChanged() {
 
 void BBDX::Window::slotWindowOpacityChanged(KWin::EffectWindow *w, qreal oldOpacity, qreal newOpacity) {
     Q_UNUSED(oldOpacity);
+    m_windowManager->invalidateBlurCoverage();
     if (w->window()->isActive() && !m_originalOpacityActive.has_value()) {
         m_originalOpacityActive = newOpacity;
     } else if (!w->window()->isActive() && !m_originalOpacityInactive.has_value()) {
@@ -138,6 +162,32 @@ void BBDX::Window::setMaximizedState(MaximizedState state) {
     qCDebug(BBDX_WINDOW) << BBDX::LOG_PREFIX << "MaximizedState changed:" << *this;
 }
 
+void BBDX::Window::setUpdateHint(UpdateHint hint) {
+    if (m_updateHint == hint) {
+        return;
+    }
+
+    m_updateHint = hint;
+
+    // the cache may still hold a result from before
+    // a static window won't refresh on its own anymore
+    m_windowManager->flushWindowCaches(this);
+
+    qCDebug(BBDX_WINDOW) << BBDX::LOG_PREFIX << "UpdateHint changed:" << *this;
+}
+
+void BBDX::Window::slotWindowDamaged() {
+    // the opaque region is part of the surface state
+    // so it can only change with a commit
+    const KWin::Region opaque = m_windowManager->windowOpaqueRegion(m_effectwindow);
+    if (opaque == m_opaqueRegion) {
+        return;
+    }
+
+    m_opaqueRegion = opaque;
+    m_windowManager->invalidateBlurCoverage();
+}
+
 void BBDX::Window::setIsBlurFullyCovered(bool toggle) {
     if (m_isBlurFullyCovered == toggle) {
         return;
@@ -147,10 +197,17 @@ void BBDX::Window::setIsBlurFullyCovered(bool toggle) {
 
     // blur was frozen, we need a full repaint to
     // refresh everything
+    // (damage behind it wasn't tracked while covered)
     if (!toggle) {
+        m_windowManager->invalidateBlurCache(m_effectwindow,
+                                             static_cast<uint>(BlurCacheInvalidationFlag::REGION),
+                                             "Exposed");
         effectwindow()->addRepaintFull();
     }
 
+    // no repaint expansion below a covered blur
+    triggerBlurRegionUpdate();
+
     qCDebug(BBDX_WINDOW) << BBDX::LOG_PREFIX << "BlurFullyCovered changed:" << *this;
 }
 
@@ -273,6 +330,32 @@ QString BBDX::Window::blurOriginToString() const {
     return s;
 }
 
+BBDX::Window::UpdateHint BBDX::Window::updateHintFromString(QStringView value) {
+    if (value == u"static") {
+        return UpdateHint::Static;
+    }
+    if (value == u"low-rate") {
+        return UpdateHint::LowRate;
+    }
+    if (value == u"live") {
+        return UpdateHint::Live;
+    }
+    return UpdateHint::None;
+}
+
+QString BBDX::Window::updateHintToString() const {
+    switch (m_updateHint) {
+        case UpdateHint::Static:
+            return QStringLiteral("Static");
+        case UpdateHint::LowRate:
+            return QStringLiteral("LowRate");
+        case UpdateHint::Live:
+            return QStringLiteral("Live");
+        default:
+            return QStringLiteral("None");
+    }
+}
+
 QString BBDX::Window::maximizedStateToString() const {
     QString s;
 
@@ -353,18 +436,22 @@ void BBDX::Window::reconfigure() {
     m_blurMenus = m_windowManager->blurMenus();
     m_blurDocks = m_windowManager->blurDocks();
 
-    if (shouldForceBlur()) {
-        m_shouldForceBlur = true;
-    } else {
-        m_shouldForceBlur = false;
-    }
+    const bool shouldForce = shouldForceBlur();
+    const bool changed = shouldForce != m_shouldForceBlur
+                         || !qFuzzyCompare(m_userBorderRadius, m_windowManager->userBorderRadius());
 
+    m_shouldForceBlur = shouldForce;
     m_userBorderRadius = m_windowManager->userBorderRadius();
 
     slotWindowOpacityChanged(effectwindow(), 0.0, effectwindow()->opacity());
-    m_windowManager->invalidateBlurCache(m_effectwindow,
-                                         static_cast<uint>(BlurCacheInvalidationFlag::REGION),
-                                         "Reconfigured window");
+
+    // only re-blur windows whose blur actually looks different now
+    // the region update itself is skipped if it's unchanged
+    if (changed) {
+        m_windowManager->invalidateBlurCache(m_effectwindow,
+                                             static_cast<uint>(BlurCacheInvalidationFlag::REGION),
+                                             "Reconfigured window");
+    }
     updateForceBlurRegion();
 }
 
@@ -622,6 +709,53 @@ qreal BBDX::Window::getEffectiveBlurOpacity(KWin::WindowPaintData &data) {
     return data.opacity();
 }
 
+BBDX::BlurProfile BBDX::Window::blurProfile() const {
+    BlurProfile profile{};
+
+    // the client knows better than our role guess
+    switch (m_updateHint) {
+        case UpdateHint::Static:
+            profile = BlurProfile::staticHint();
+            break;
+        case UpdateHint::LowRate:
+            profile = BlurProfile::lowRateHint();
+            break;
+        case UpdateHint::Live:
+            break;
+        default:
+            profile = m_windowManager->rolePolicy(role());
+            break;
+    }
+
+    if (m_isUserMovedResized) {
+        profile = profile.combined(BlurProfile::motion());
+    }
+
+    return profile;
+}
+
+BBDX::Window::Role BBDX::Window::role() const {
+    if (isMenu()) {
+        return Role::Menu;
+    }
+
+    if (m_effectwindow->isNotification()
+        || m_effectwindow->isCriticalNotification()
+        || m_effectwindow->isOnScreenDisplay()) {
+        return Role::Notification;
+    }
+
+    if (m_effectwindow->isDock() || isPlasmaSurface()) {
+        return Role::Dock;
+    }
+
+    if (m_effectwindow == KWin::effects->activeWindow()) {
+        return Role::Active;
+    }
+
+    return Role::Inactive;
+}
+
 bool BBDX::Window::isPlasmaSurface() const {
     // Plasma surfaces must specify their own blur
     if (!(blurOriginIs(BlurOrigin::RequestedContent)))
@@ -680,6 +814,7 @@ QDebug operator<<(QDebug &debug, const BBDX::Window &window) {
     debug << "blurOrigin:" << window.blurOriginToString() << "\n";
     debug << "maximizedState:" << window.maximizedStateToString() << "\n";
     debug << "isBlurFullyCovered:" << window.isBlurFullyCovered() << "\n";
+    debug << "updateHint:" << window.updateHintToString() << "\n";
     return debug;
 }
 } // namespace BBDX
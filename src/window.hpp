@@ -1,9 +1,11 @@
 #pragma once
 
 #include "kwin_compat.hpp"
+#include "blur_profile.hpp"
 
 #include <QObject>
 #include <QRegion>
+#include <QSize>
 
 #include <chrono>
 #include <optional>
@@ -40,6 +42,24 @@ public:
         Ended
     };
 
+    // roles with their own blur policy
+    enum class Role {
+        Active,
+        Inactive,
+        Menu,
+        Dock,
+        Notification,
+    };
+
+    // client provided hint how often the area behind
+    // the window changes (see BlurEffect::updateBlurHint())
+    enum class UpdateHint {
+        None,
+        Static,
+        LowRate,
+        Live,
+    };
+
     enum class BlurOrigin : unsigned int {
         RequestedContent = 1 << 0,
         RequestedFrame   = 1 << 1,
@@ -80,9 +100,23 @@ private:
     // track whether window is currently being transformed
     bool m_isTransformed{false};
 
+    // track interactive move/resize
+    bool m_isUserMovedResized{false};
+
+    // frame size at the last geometry change
+    // to tell pure moves apart from resizes
+    QSize m_frameSize{};
+
+    // client provided blur update hint
+    UpdateHint m_updateHint{UpdateHint::None};
+
     // track whether window's blur region is currently fully covered
     bool m_isBlurFullyCovered{false};
 
+    // surface opaque region at the last damage
+    // to notice clients changing it without moving
+    KWin::Region m_opaqueRegion{};
+
     // track whether window should be blurred even
     // when PAINT_WINDOW_TRANSFORMED is set
     bool m_shouldBlurWhileTransformed{false};
@@ -119,6 +153,7 @@ private:
     bool blurOriginIs(BlurOrigin origin) const;
     QString blurOriginToString() const;
     QString maximizedStateToString() const;
+    QString updateHintToString() const;
 
 public Q_SLOTS:
     void slotMinimizedChanged();
@@ -127,6 +162,7 @@ public Q_SLOTS:
     void slotWindowStartUserMovedResized();
     void slotWindowFinishUserMovedResized();
     void slotWindowOpacityChanged(KWin::EffectWindow *w, qreal oldOpacity, qreal newOpacity);
+    void slotWindowDamaged();
 
 public:
     explicit Window(WindowManager *wm, KWin::EffectWindow *w);
@@ -137,6 +173,7 @@ public:
     void setIsTransformed(bool toggle);
     void setMaximizedState(MaximizedState state);
     void setIsBlurFullyCovered(bool toggle);
+    void setUpdateHint(UpdateHint hint);
 
     /**
      * getters
@@ -146,9 +183,21 @@ public:
     std::optional<KWin::RegionF> forceBlurFrame() const { return m_forceBlurFrame; };
     bool shouldBlurWhileTransformed() const;
     bool isBlurFullyCovered() const { return m_isBlurFullyCovered; }
+    bool isUserMovedResized() const { return m_isUserMovedResized; }
+    bool isFullScreen() const { return m_isFullScreen; }
+    UpdateHint updateHint() const { return m_updateHint; }
+
+    /**
+     * Parse an update hint value ("static", "low-rate" or "live")
+     * anything else is UpdateHint::None
+     */
+    static UpdateHint updateHintFromString(QStringView value);
 
     /**
      * reconfigure hook
+     *
+     * Only invalidates the cache if the force blur
+     * decision or the border radius changed
      */
     void reconfigure();
 
@@ -187,6 +236,18 @@ public:
      */
     bool isMenu() const;
 
+    /**
+     * Get the quality/update rate profile for this window's blur
+     * depending on its role policy (or update hint if set)
+     * and current state (e.g. being dragged)
+     */
+    BlurProfile blurProfile() const;
+
+    /**
+     * The role used to pick this window's blur policy
+     */
+    Role role() const;
+
     /**
      * Whether this window is blurred in any way (requested or forced)
      */
@@ -13,6 +13,7 @@
 #include <effect/effectwindow.h>
 #include <qloggingcategory.h>
 #include <scene/borderradius.h>
+#include <scene/surfaceitem.h>
 #include <scene/windowitem.h>
 #include <window.h>
 
@@ -27,6 +28,7 @@
 #include <QRegularExpressionMatch>
 #include <QString>
 
+#include <algorithm>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -43,12 +45,20 @@ BBDX::WindowManager::WindowManager(BBDX::BlurEffect *effect) {
 
     connect(KWin::effects, &KWin::EffectsHandler::windowAdded, this, &WindowManager::slotWindowAdded);
     connect(KWin::effects, &KWin::EffectsHandler::windowDeleted, this, &WindowManager::slotWindowDeleted);
+    connect(KWin::effects, &KWin::EffectsHandler::desktopChanged, this, &WindowManager::slotDesktopChanged);
+
+    // anything that can expose or cover a blurred window
+    connect(KWin::effects, &KWin::EffectsHandler::stackingOrderChanged, this, &WindowManager::invalidateBlurCoverage);
+    connect(KWin::effects, &KWin::EffectsHandler::windowShown, this, &WindowManager::invalidateBlurCoverage);
+    connect(KWin::effects, &KWin::EffectsHandler::windowHidden, this, &WindowManager::invalidateBlurCoverage);
+    connect(KWin::effects, &KWin::EffectsHandler::activeFullScreenEffectChanged, this, &WindowManager::invalidateBlurCoverage);
 }
 
 void BBDX::WindowManager::slotWindowAdded(KWin::EffectWindow *w) {
     auto window = std::make_unique<BBDX::Window>(this, w);
 
     m_windows.insert_or_assign(w, std::move(window));
+    invalidateBlurCoverage();
 
     if (w->isDock()) {
         m_docks.insert(w);
@@ -62,12 +72,66 @@ void BBDX::WindowManager::slotWindowDeleted(KWin::EffectWindow *w) {
     if (const auto it = m_windows.find(w); it != m_windows.end()) {
         qCDebug(WINDOW_MANAGER) << BBDX::LOG_PREFIX << "Window removed:" << *(it->second);
         m_windows.erase(it);
+        invalidateBlurCoverage();
     }
 
     if (const auto it = m_docks.find(w); it != m_docks.end()) {
         m_docks.erase(it);
         refreshMaximizedStateAll();
     }
+
+    std::erase(m_prewarmQueue, w);
+}
+
+void BBDX::WindowManager::slotDesktopChanged(KWin::VirtualDesktop *oldDesktop, KWin::VirtualDesktop *newDesktop, KWin::EffectWindow *with) {
+    Q_UNUSED(with);
+
+    // a new switch supersedes whatever is left from the previous one
+    m_prewarmQueue.clear();
+    m_lastPrewarm = std::chrono::steady_clock::time_point{};
+    invalidateBlurCoverage();
+
+    std::vector<std::pair<const KWin::EffectWindow *, qreal>> incoming{};
+
+    for (const auto &[kWindow, bbdxWindow] : m_windows) {
+        if (!bbdxWindow->isBlurred()) {
+            continue;
+        }
+
+        // windows visible on both desktops (e.g. "on all desktops")
+        // never left the screen and still have a warm cache
+        if (!kWindow->isOnDesktop(newDesktop) || kWindow->isOnDesktop(oldDesktop)) {
+            continue;
+        }
+
+        if (kWindow->isMinimized() || !kWindow->screen()) {
+            continue;
+        }
+
+        const KWin::RectF visibleRect = kWindow->frameGeometry().intersected(kWindow->screen()->geometryF());
+        incoming.emplace_back(kWindow, visibleRect.width() * visibleRect.height());
+    }
+
+    if (incoming.empty()) {
+        return;
+    }
+
+    // largest on-screen area first, these are the most noticable ones
+    std::ranges::sort(incoming, [](const auto &a, const auto &b) {
+        return a.second > b.second;
+    });
+
+    for (const auto &[kWindow, area] : incoming) {
+        m_prewarmQueue.push_back(kWindow);
+    }
+
+    // spread the queue over the first frames of the slide animation
+    constexpr size_t prewarmFrames{8};
+    m_prewarmPerFrame = (m_prewarmQueue.size() + prewarmFrames - 1) / prewarmFrames;
+
+    qCDebug(WINDOW_MANAGER) << BBDX::LOG_PREFIX
+                            << "Desktop switch: pre-warming" << m_prewarmQueue.size() << "windows,"
+                            << m_prewarmPerFrame << "per frame";
 }
 
 BBDX::Window* BBDX::WindowManager::findWindow(const KWin::EffectWindow *w) const {
@@ -155,6 +219,37 @@ void BBDX::WindowManager::reconfigure() {
 
     m_userBorderRadius = config->cornerRadius();
 
+    // 0 follows the output's refresh rate
+    auto roleRateLimit = [](int rateLimit) -> std::optional<std::chrono::milliseconds> {
+        if (rateLimit <= 0) {
+            return std::nullopt;
+        }
+        return std::chrono::milliseconds{rateLimit};
+    };
+
+    m_rolePolicies.enabled = config->blurCachePolicies();
+    m_rolePolicies.active = BlurProfile{
+        .rateLimit = roleRateLimit(config->blurCachePolicyActiveRateLimit()),
+    };
+    m_rolePolicies.inactive = BlurProfile{
+        .iterationReduction = static_cast<size_t>(config->blurCachePolicyInactiveIterationReduction()),
+        .resolutionScale = config->blurCachePolicyInactiveResolution() / 100.0,
+        .rateLimit = roleRateLimit(config->blurCachePolicyInactiveRateLimit()),
+    };
+    m_rolePolicies.menu = BlurProfile{
+        .rateLimit = roleRateLimit(config->blurCachePolicyMenuRateLimit()),
+    };
+    m_rolePolicies.dock = BlurProfile{
+        .rateLimit = roleRateLimit(config->blurCachePolicyDockRateLimit()),
+    };
+    m_rolePolicies.notification = BlurProfile{
+        .rateLimit = roleRateLimit(config->blurCachePolicyNotificationRateLimit()),
+    };
+
+    m_asyncFlushMode = static_cast<AsyncFlushMode>(config->asyncFlushMode());
+}
+
+void BBDX::WindowManager::reconfigureWindows() const {
     for (const auto &[_, window] : m_windows) {
         window->reconfigure();
     }
@@ -282,6 +377,12 @@ void BBDX::WindowManager::invalidateBlurCache(KWin::EffectWindow *w, uint flags,
     }
 }
 
+void BBDX::WindowManager::invalidateAllBlurCaches(uint flags, const char *reason) const {
+    for (const auto &[kWindow, bbdxWindow] : m_windows) {
+        invalidateBlurCache(bbdxWindow->effectwindow(), flags, reason);
+    }
+}
+
 void BBDX::WindowManager::setWindowIsTransformed(const KWin::EffectWindow *w, bool toggle) const {
     const auto window = findWindow(w);
 
@@ -291,6 +392,15 @@ void BBDX::WindowManager::setWindowIsTransformed(const KWin::EffectWindow *w, bo
     window->setIsTransformed(toggle);
 }
 
+void BBDX::WindowManager::setWindowUpdateHint(const KWin::EffectWindow *w, BBDX::Window::UpdateHint hint) const {
+    const auto window = findWindow(w);
+
+    if (!window)
+        return;
+
+    window->setUpdateHint(hint);
+}
+
 bool BBDX::WindowManager::windowShouldBlurWhileTransformed(const KWin::EffectWindow *w) const {
     const auto window = findWindow(w);
 
@@ -339,6 +449,25 @@ qreal BBDX::WindowManager::getEffectiveBlurOpacity(const KWin::EffectWindow *w,
     return window->getEffectiveBlurOpacity(data);
 }
 
+KWin::Region BBDX::WindowManager::windowOpaqueRegion(const KWin::EffectWindow *w) const {
+    if (w->opacity() < 1.0) {
+        return KWin::Region();
+    }
+
+    // most clients use ARGB buffers, what's actually opaque
+    // is only known from the surface's opaque region
+    const KWin::SurfaceItem *surfaceItem = w->windowItem() ? w->windowItem()->surfaceItem() : nullptr;
+    if (!surfaceItem) {
+        return KWin::Region();
+    }
+
+    KWin::Region opaque;
+    for (const KWin::Rect &rect : surfaceItem->opaque().rects()) {
+        opaque += BBDX::rectRoundedIn(surfaceItem->mapToScene(KWin::RectF(rect)));
+    }
+    return opaque;
+}
+
 bool BBDX::WindowManager::windowIsBlurFullyCovered(KWin::EffectWindow *w) const {
     const auto window = findWindow(w);
 
@@ -350,6 +479,72 @@ bool BBDX::WindowManager::windowIsBlurFullyCovered(KWin::EffectWindow *w) const
     return window->isBlurFullyCovered();
 }
 
+void BBDX::WindowManager::updateBlurCoverage() {
+    if (!m_blurCoverageDirty) {
+        return;
+    }
+    m_blurCoverageDirty = false;
+
+    // effects like the overview show every window
+    const bool fullScreenEffect = KWin::effects->activeFullScreenEffect() != nullptr;
+
+    // opaque area of the windows above, top to bottom
+    KWin::Region opaque{};
+    const auto stackingOrder = KWin::effects->stackingOrder();
+    for (auto it = stackingOrder.crbegin(); it != stackingOrder.crend(); ++it) {
+        KWin::EffectWindow *w = *it;
+        const bool visible = w->isVisible() && w->isOnCurrentDesktop() && !w->isMinimized();
+
+        if (const auto window = findWindow(w); window && window->isBlurred()) {
+            KWin::Region exposed{KWin::Rect(w->frameGeometry().toRect())};
+            exposed -= opaque;
+            window->setIsBlurFullyCovered(!fullScreenEffect && visible && exposed.isEmpty());
+        }
+
+        // the surface's opaque region leaves out decorations
+        // (which may have rounded corners) and translucent parts
+        if (visible) {
+            opaque += windowOpaqueRegion(w);
+        }
+    }
+}
+
+bool BBDX::WindowManager::viewIsCoveredByFullscreen(const KWin::RenderView *view) const {
+    // effects like the overview paint windows transformed
+    if (KWin::effects->activeFullScreenEffect()) {
+        return false;
+    }
+
+#if defined(BBDX_X11)
+    const KWin::LogicalOutput *output = view;
+#else
+    const KWin::LogicalOutput *output = view->logicalOutput();
+#endif
+    const KWin::Rect outputRect{output->geometry()};
+
+    // only the topmost window touching the view decides
+    const auto stackingOrder = KWin::effects->stackingOrder();
+    for (auto it = stackingOrder.crbegin(); it != stackingOrder.crend(); ++it) {
+        const KWin::EffectWindow *w = *it;
+        const KWin::Rect windowRect{KWin::Rect(w->frameGeometry().toRect())};
+        if (!w->isVisible() || !w->isOnCurrentDesktop() || w->isMinimized()
+            || !windowRect.intersects(outputRect)) {
+            continue;
+        }
+
+        const auto window = findWindow(w);
+        const bool isFullScreen = window ? window->isFullScreen() : w->isFullScreen();
+
+        // games and players commonly use ARGB buffers,
+        // trust the surface's opaque region instead of hasAlpha()
+        return isFullScreen
+               && w->screen() == output
+               && (KWin::Region(outputRect) - windowOpaqueRegion(w)).isEmpty();
+    }
+
+    return false;
+}
+
 void BBDX::WindowManager::repaintAllBlurredWindows() const {
     for (const auto &[kWindow, bbdxWindow] : m_windows) {
         if (!bbdxWindow->isBlurred()) {
@@ -366,6 +561,20 @@ void BBDX::WindowManager::flushWindowCaches(BBDX::Window *window) const {
         return;
     }
 
+    auto &effectData = it->second;
+    for (auto &[view, renderData] : effectData.render) {
+        if (auto cacheEntry = renderData.cache.get()) {
+            cacheEntry->requestFlush();
+        }
+    }
+}
+
+void BBDX::WindowManager::forceFlushWindowCaches(BBDX::Window *window) const {
+    auto it = m_effect->m_windows.find(window->effectwindow());
+    if (it == m_effect->m_windows.end()) {
+        return;
+    }
+
     auto &effectData = it->second;
     for (auto &[view, renderData] : effectData.render) {
         if (auto cacheEntry = renderData.cache.get()) {
@@ -399,3 +608,100 @@ void BBDX::WindowManager::flushAllWindowCachesFor(std::chrono::milliseconds dura
         flushWindowCachesFor(bbdxWindow.get(), duration);
     }
 }
+
+void BBDX::WindowManager::advanceDesktopSwitchPrewarm(std::chrono::microseconds refreshInterval) {
+    if (m_prewarmQueue.empty()) {
+        return;
+    }
+
+    // another view already advanced it this frame
+    // (frames of different outputs are never exactly in sync, allow some slack)
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPrewarm < refreshInterval * 3 / 4) {
+        return;
+    }
+    m_lastPrewarm = now;
+
+    const size_t count = std::min(m_prewarmPerFrame, m_prewarmQueue.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (const auto window = findWindow(m_prewarmQueue[i])) {
+            // flush existing entries and make sure windows without
+            // render data get painted so their entries are created now
+            // (not deferrable, the scheduler could push it past the slide)
+            forceFlushWindowCaches(window);
+            window->effectwindow()->addRepaintFull();
+        }
+    }
+
+    m_prewarmQueue.erase(m_prewarmQueue.begin(), m_prewarmQueue.begin() + count);
+}
+
+bool BBDX::WindowManager::windowIsPrewarmPending(const KWin::EffectWindow *w) const {
+    return std::ranges::find(m_prewarmQueue, w) != m_prewarmQueue.end();
+}
+
+BBDX::BlurProfile BBDX::WindowManager::windowBlurProfile(const KWin::EffectWindow *w, const KWin::RenderView *view) const {
+    const auto window = findWindow(w);
+
+    if (!window)
+        return BlurProfile{};
+
+    BlurProfile profile = window->blurProfile();
+
+    if (m_effect->powerSaving()) {
+        profile = profile.combined(BlurProfile::powerSaving());
+    }
+
+    if (m_effect->windowHasVideoDamage(w, view)) {
+        profile = profile.combined(BlurProfile::videoDamage());
+    }
+
+    if (m_effect->windowIsOverBlurBudget(w, view)) {
+        profile = profile.combined(BlurProfile::overBudget());
+    }
+
+    // an outdated frame of blur is only acceptable
+    // where nobody is looking closely
+    switch (m_asyncFlushMode) {
+        case AsyncFlushMode::ASYNC_FLUSH_ALWAYS:
+            profile.asyncFlush = true;
+            break;
+        case AsyncFlushMode::ASYNC_FLUSH_BACKGROUND: {
+            const auto role = window->role();
+            profile.asyncFlush = role != Window::Role::Active && role != Window::Role::Menu;
+            break;
+        }
+        case AsyncFlushMode::ASYNC_FLUSH_OFF:
+        default:
+            profile.asyncFlush = false;
+            break;
+    }
+
+    return profile;
+}
+
+BBDX::BlurProfile BBDX::WindowManager::rolePolicy(BBDX::Window::Role role) const {
+    if (!m_rolePolicies.enabled) {
+        return BlurProfile{};
+    }
+
+    switch (role) {
+        case Window::Role::Active:
+            return m_rolePolicies.active;
+        case Window::Role::Inactive:
+            return m_rolePolicies.inactive;
+        case Window::Role::Menu:
+            return m_rolePolicies.menu;
+        case Window::Role::Dock: {
+            // panels barely ever move, in wallpaper mode
+            // there is no reason to ever refresh them automatically
+            BlurProfile profile = m_rolePolicies.dock;
+            profile.isStatic = m_effect->blurCache()->blitMode() == BlitMode::WALLPAPER;
+            return profile;
+        }
+        case Window::Role::Notification:
+            return m_rolePolicies.notification;
+        [[unlikely]] default:
+            return BlurProfile{};
+    }
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "kwin_compat.hpp"
+#include "blur_profile.hpp"
+#include "settings.hpp"
 #include "window.hpp"
 
 #include <effect/effect.h>
@@ -21,9 +23,14 @@
 #include <chrono>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace KWin {
     class BorderRadius;
+    class VirtualDesktop;
+#if !defined(BBDX_X11)
+    class RenderView;
+#endif
 }
 
 namespace BBDX {
@@ -61,6 +68,31 @@ private:
     // user configured border radius
     qreal m_userBorderRadius{0.0};
 
+    // user configured per role blur policies
+    struct {
+        bool enabled{false};
+        BBDX::BlurProfile active{};
+        BBDX::BlurProfile inactive{};
+        BBDX::BlurProfile menu{};
+        BBDX::BlurProfile dock{};
+        BBDX::BlurProfile notification{};
+    } m_rolePolicies;
+
+    // which windows may show their previous blur while flushing
+    AsyncFlushMode m_asyncFlushMode{AsyncFlushMode::ASYNC_FLUSH_OFF};
+
+    // blurred windows entering the screen on a desktop switch
+    // ranked by on-screen area (largest first)
+    std::vector<const KWin::EffectWindow *> m_prewarmQueue{};
+    // how many windows of m_prewarmQueue get flushed per frame
+    // and when the last batch was (the queue is shared by all views)
+    size_t m_prewarmPerFrame{1};
+    std::chrono::steady_clock::time_point m_lastPrewarm{};
+
+    // set whenever stacking, geometry, visibility or opacity changed
+    // so updateBlurCoverage() has to recompute it
+    bool m_blurCoverageDirty{true};
+
     // match helpers
     bool matchesWindowClassFixed(const KWin::EffectWindow *w) const;
     bool matchesWindowClassRegex(const KWin::EffectWindow *w) const;
@@ -78,6 +110,7 @@ private:
 public Q_SLOT:
     void slotWindowAdded(KWin::EffectWindow *w);
     void slotWindowDeleted(KWin::EffectWindow *w);
+    void slotDesktopChanged(KWin::VirtualDesktop *oldDesktop, KWin::VirtualDesktop *newDesktop, KWin::EffectWindow *with);
 
 public:
     explicit WindowManager(BBDX::BlurEffect *effect);
@@ -87,6 +120,12 @@ public:
      */
     void reconfigure();
 
+    /**
+     * Re-evaluate all windows against the current
+     * window related settings (classes, radius, ...)
+     */
+    void reconfigureWindows() const;
+
     /**
      * Refresh maximized state of a window / of all windows
      */
@@ -117,12 +156,22 @@ public:
      */
     void invalidateBlurCache(KWin::EffectWindow *w, uint flags, const char *reason) const;
 
+    /**
+     * invalidateBlurCache() for all windows
+     */
+    void invalidateAllBlurCaches(uint flags, const char *reason) const;
+
     /**
      * Set the "window is transformed" flag on a window
      * (scaled, translated or PAINT_WINDOW_TRANSFORMED set)
      */
     void setWindowIsTransformed(const KWin::EffectWindow *w, bool toggle) const;
 
+    /**
+     * Set the client provided blur update hint of a window
+     */
+    void setWindowUpdateHint(const KWin::EffectWindow *w, BBDX::Window::UpdateHint hint) const;
+
     /**
      * Check if this window should currently be blurred
      * even when PAINT_WINDOW_TRANSFORMED is set
@@ -153,12 +202,35 @@ public:
      */
     qreal getEffectiveBlurOpacity(const KWin::EffectWindow *w, KWin::WindowPaintData &data) const;
 
+    /**
+     * Get the opaque part of the provided window's surface
+     * in scene coordinates (from the client's opaque region)
+     *
+     * Empty if the window as a whole is translucent
+     */
+    KWin::Region windowOpaqueRegion(const KWin::EffectWindow *w) const;
+
     /**
      * Check if the provided window's blur region is fully covered by
-     * the frame geometry of other windows
+     * opaque windows above it (see updateBlurCoverage())
      */
     bool windowIsBlurFullyCovered(KWin::EffectWindow *w) const;
 
+    /**
+     * Mark the blur coverage outdated / recompute it if it is
+     *
+     * A blurred window is covered if opaque windows above it
+     * hide its whole frame. Called once per prePaintScreen.
+     */
+    void invalidateBlurCoverage() { m_blurCoverageDirty = true; }
+    void updateBlurCoverage();
+
+    /**
+     * Check if the topmost window on view is an opaque
+     * fullscreen window hiding everything below it
+     */
+    bool viewIsCoveredByFullscreen(const KWin::RenderView *view) const;
+
     /**
      * Add a full repaint to all blurred windows
      */
@@ -166,8 +238,12 @@ public:
 
     /**
      * Flush all caches of a window
+     *
+     * Plain flushes may be deferred by the BlurCache flush scheduler,
+     * the forced and timed variants always flush
      */
     void flushWindowCaches(BBDX::Window *window) const;
+    void forceFlushWindowCaches(BBDX::Window *window) const;
     void flushWindowCachesFor(BBDX::Window *window, std::chrono::milliseconds duration) const;
 
     /**
@@ -175,6 +251,40 @@ public:
      */
     void flushAllWindowCaches() const;
     void flushAllWindowCachesFor(std::chrono::milliseconds duration) const;
+
+    /**
+     * Flush the next batch of windows queued by a desktop switch
+     *
+     * Called from every prePaintScreen but advances at most once
+     * per refreshInterval (of the view being painted) so the cache
+     * flushes of incoming windows are spread across the slide animation
+     * no matter how many outputs there are
+     */
+    void advanceDesktopSwitchPrewarm(std::chrono::microseconds refreshInterval);
+
+    /**
+     * Check if this window is still waiting for its
+     * desktop switch pre-warm flush
+     *
+     * Such windows don't re-flush until it's their turn, they keep
+     * showing what they have cached meanwhile (entries without
+     * complete content still flush right away)
+     */
+    bool windowIsPrewarmPending(const KWin::EffectWindow *w) const;
+
+    /**
+     * Get the blur profile of the provided window on view
+     * (full quality for unmanaged windows)
+     */
+    BBDX::BlurProfile windowBlurProfile(const KWin::EffectWindow *w, const KWin::RenderView *view) const;
+
+    /**
+     * Get the configured base profile for a window role
+     *
+     * Its rate limit replaces the global cache rate limit,
+     * state based profiles (e.g. motion) are combined on top
+     */
+    BBDX::BlurProfile rolePolicy(BBDX::Window::Role role) const;
 };
 
 } // namespace KWin
@@ -0,0 +1,66 @@
+#include "blur_cache_tiles.hpp"
+
+#include "kwin_compat.hpp"
+
+#if KWIN_VERSION >= KWIN_VERSION_CODE(6, 5, 80)
+#  include <core/rect.h>
+#  include <core/region.h>
+#endif
+
+#include <QObject>
+#include <QTest>
+
+using BBDX::BlurCacheTiles;
+
+class BlurCacheTilesTest : public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void tileSplitAcrossBands();
+    void partiallyCoveredTileStaysInvalid();
+    void flushOnlyClearsRenderedDirtyTiles();
+};
+
+void BlurCacheTilesTest::tileSplitAcrossBands() {
+    BlurCacheTiles tiles{};
+    tiles.resize(QSize{128, 128});
+
+    // the region splits into a band above y = 20 and one below it
+    // so no single rect contains the top left tile
+    KWin::Region region{KWin::Rect{0, 0, 100, 20}};
+    region += KWin::Rect{0, 20, 64, 108};
+    QVERIFY(region.rects().size() > 1);
+
+    tiles.markFlushed(region);
+
+    QVERIFY(tiles.covers(KWin::Region{KWin::Rect{0, 0, 64, 64}}));
+    QVERIFY(tiles.covers(KWin::Region{KWin::Rect{0, 64, 64, 64}}));
+    QVERIFY(!tiles.covers(KWin::Region{KWin::Rect{64, 0, 64, 64}}));
+}
+
+void BlurCacheTilesTest::partiallyCoveredTileStaysInvalid() {
+    BlurCacheTiles tiles{};
+    tiles.resize(QSize{128, 64});
+
+    KWin::Region region{KWin::Rect{0, 0, 64, 32}};
+    region += KWin::Rect{0, 40, 64, 24};
+
+    tiles.markFlushed(region);
+
+    QVERIFY(!tiles.covers(KWin::Region{KWin::Rect{0, 0, 64, 64}}));
+}
+
+void BlurCacheTilesTest::flushOnlyClearsRenderedDirtyTiles() {
+    BlurCacheTiles tiles{};
+    tiles.resize(QSize{128, 64});
+
+    tiles.markDirty(KWin::Region{KWin::Rect{0, 0, 128, 64}});
+    tiles.markFlushed(KWin::Region{KWin::Rect{0, 0, 64, 64}});
+
+    QVERIFY(tiles.isDirty());
+    QVERIFY((tiles.dirtyRegion() == KWin::Region{KWin::Rect{64, 0, 64, 64}}));
+}
+
+QTEST_GUILESS_MAIN(BlurCacheTilesTest)
+
+#include "blur_cache_tiles_test.moc"
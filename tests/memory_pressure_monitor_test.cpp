@@ -0,0 +1,74 @@
+#include "memory_pressure_monitor.hpp"
+
+#include <QObject>
+#include <QTemporaryFile>
+#include <QTest>
+
+using BBDX::MemoryPressureMonitor;
+using Level = BBDX::MemoryPressureMonitor::Level;
+using Pressure = BBDX::MemoryPressureMonitor::Pressure;
+
+class MemoryPressureMonitorTest : public QObject {
+    Q_OBJECT
+
+private:
+    // fake PSI file, removed with the test
+    QTemporaryFile m_file{};
+
+    void writeSource(const QByteArray &content);
+
+private Q_SLOTS:
+    void init();
+    void readsSomeAndFull();
+    void missingFileFails();
+    void malformedFileFails();
+    void levelsWithHysteresis();
+};
+
+void MemoryPressureMonitorTest::writeSource(const QByteArray &content) {
+    QVERIFY(m_file.resize(0));
+    QVERIFY(m_file.seek(0));
+    QCOMPARE(m_file.write(content), content.size());
+    QVERIFY(m_file.flush());
+}
+
+void MemoryPressureMonitorTest::init() {
+    if (!m_file.isOpen()) {
+        QVERIFY(m_file.open());
+    }
+}
+
+void MemoryPressureMonitorTest::readsSomeAndFull() {
+    writeSource("some avg10=12.50 avg60=3.00 avg300=1.00 total=1234\n"
+                "full avg10=4.25 avg60=1.00 avg300=0.50 total=567\n");
+
+    const auto pressure = MemoryPressureMonitor::readPressure(m_file.fileName());
+    QVERIFY(pressure.has_value());
+    QCOMPARE(pressure->some, 12.5);
+    QCOMPARE(pressure->full, 4.25);
+}
+
+void MemoryPressureMonitorTest::missingFileFails() {
+    QVERIFY(!MemoryPressureMonitor::readPressure(m_file.fileName() + QStringLiteral(".missing")).has_value());
+}
+
+void MemoryPressureMonitorTest::malformedFileFails() {
+    writeSource("not a pressure file\n");
+    QVERIFY(!MemoryPressureMonitor::readPressure(m_file.fileName()).has_value());
+}
+
+void MemoryPressureMonitorTest::levelsWithHysteresis() {
+    QCOMPARE(MemoryPressureMonitor::levelFor(Level::None, Pressure{.some = 5.0, .full = 0.0}), Level::None);
+    QCOMPARE(MemoryPressureMonitor::levelFor(Level::None, Pressure{.some = 15.0, .full = 0.0}), Level::Moderate);
+    QCOMPARE(MemoryPressureMonitor::levelFor(Level::None, Pressure{.some = 15.0, .full = 12.0}), Level::Critical);
+
+    // levels are only left once pressure dropped below half of their threshold
+    QCOMPARE(MemoryPressureMonitor::levelFor(Level::Moderate, Pressure{.some = 6.0, .full = 0.0}), Level::Moderate);
+    QCOMPARE(MemoryPressureMonitor::levelFor(Level::Moderate, Pressure{.some = 4.0, .full = 0.0}), Level::None);
+    QCOMPARE(MemoryPressureMonitor::levelFor(Level::Critical, Pressure{.some = 25.0, .full = 0.0}), Level::Critical);
+    QCOMPARE(MemoryPressureMonitor::levelFor(Level::Critical, Pressure{.some = 15.0, .full = 2.0}), Level::Moderate);
+}
+
+QTEST_GUILESS_MAIN(MemoryPressureMonitorTest)
+
+#include "memory_pressure_monitor_test.moc"
@@ -0,0 +1,179 @@
+#include "power_profile_monitor.hpp"
+
+#include "blurconfig.h"
+#include "settings.hpp"
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusMessage>
+#include <QObject>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTest>
+#include <QVariantMap>
+
+#include <memory>
+
+using BBDX::PowerProfileMonitor;
+
+static const QString s_powerProfilesService{QStringLiteral("net.hadess.PowerProfiles")};
+static const QString s_powerProfilesPath{QStringLiteral("/net/hadess/PowerProfiles")};
+static const QString s_upowerService{QStringLiteral("org.freedesktop.UPower")};
+static const QString s_upowerPath{QStringLiteral("/org/freedesktop/UPower")};
+
+/**
+ * Stand-ins for power-profiles-daemon and UPower
+ * exposing only the properties PowerProfileMonitor reads
+ */
+class MockPowerProfiles : public QObject {
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.hadess.PowerProfiles")
+    Q_PROPERTY(QString ActiveProfile READ activeProfile)
+
+public:
+    QString m_activeProfile{QStringLiteral("balanced")};
+    QString activeProfile() const { return m_activeProfile; }
+};
+
+class MockUPower : public QObject {
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.UPower")
+    Q_PROPERTY(bool OnBattery READ onBattery)
+
+public:
+    bool m_onBattery{false};
+    bool onBattery() const { return m_onBattery; }
+};
+
+class PowerProfileMonitorTest : public QObject {
+    Q_OBJECT
+
+private:
+    QDBusConnection m_bus{QString()};
+    MockPowerProfiles m_powerProfiles{};
+    MockUPower m_upower{};
+
+    void setActiveProfile(const QString &profile);
+    void setOnBattery(bool onBattery);
+    std::unique_ptr<PowerProfileMonitor> createMonitor(BBDX::PowerSavingMode mode);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanupTestCase();
+    void neverSavesPower();
+    void followsPowerSaverProfile();
+    void followsBattery();
+    void daemonVanishing();
+};
+
+void PowerProfileMonitorTest::setActiveProfile(const QString &profile) {
+    m_powerProfiles.m_activeProfile = profile;
+
+    auto signal = QDBusMessage::createSignal(s_powerProfilesPath, QStringLiteral("org.freedesktop.DBus.Properties"), QStringLiteral("PropertiesChanged"));
+    signal << QStringLiteral("net.hadess.PowerProfiles") << QVariantMap{{QStringLiteral("ActiveProfile"), profile}} << QStringList{};
+    QVERIFY(m_bus.send(signal));
+}
+
+void PowerProfileMonitorTest::setOnBattery(bool onBattery) {
+    m_upower.m_onBattery = onBattery;
+
+    auto signal = QDBusMessage::createSignal(s_upowerPath, QStringLiteral("org.freedesktop.DBus.Properties"), QStringLiteral("PropertiesChanged"));
+    signal << QStringLiteral("org.freedesktop.UPower") << QVariantMap{{QStringLiteral("OnBattery"), onBattery}} << QStringList{};
+    QVERIFY(m_bus.send(signal));
+}
+
+std::unique_ptr<PowerProfileMonitor> PowerProfileMonitorTest::createMonitor(BBDX::PowerSavingMode mode) {
+    BBDX::BlurConfig::setPowerSavingMode(mode);
+
+    auto monitor = PowerProfileMonitor::create(m_bus);
+    monitor->reconfigure();
+    return monitor;
+}
+
+void PowerProfileMonitorTest::initTestCase() {
+    QStandardPaths::setTestModeEnabled(true);
+
+    // the daemons live on the system bus, the mocks on the session bus
+    m_bus = QDBusConnection::sessionBus();
+    if (!m_bus.isConnected()) {
+        QSKIP("No session bus (run with dbus-run-session)");
+    }
+
+    QVERIFY(m_bus.registerObject(s_powerProfilesPath, &m_powerProfiles, QDBusConnection::ExportAllProperties));
+    QVERIFY(m_bus.registerObject(s_upowerPath, &m_upower, QDBusConnection::ExportAllProperties));
+    QVERIFY(m_bus.registerService(s_powerProfilesService));
+    QVERIFY(m_bus.registerService(s_upowerService));
+}
+
+void PowerProfileMonitorTest::init() {
+    m_powerProfiles.m_activeProfile = QStringLiteral("balanced");
+    m_upower.m_onBattery = false;
+
+    if (!m_bus.interface()->isServiceRegistered(s_powerProfilesService).value()) {
+        QVERIFY(m_bus.registerService(s_powerProfilesService));
+    }
+}
+
+void PowerProfileMonitorTest::cleanupTestCase() {
+    m_bus.unregisterService(s_powerProfilesService);
+    m_bus.unregisterService(s_upowerService);
+    m_bus.unregisterObject(s_powerProfilesPath);
+    m_bus.unregisterObject(s_upowerPath);
+}
+
+void PowerProfileMonitorTest::neverSavesPower() {
+    m_powerProfiles.m_activeProfile = QStringLiteral("power-saver");
+    m_upower.m_onBattery = true;
+
+    auto monitor = createMonitor(BBDX::PowerSavingMode::POWER_SAVING_NEVER);
+    QSignalSpy spy{monitor.get(), &PowerProfileMonitor::powerSavingChanged};
+
+    // give both fetches a chance to come back
+    QTest::qWait(200);
+    QVERIFY(!monitor->powerSaving());
+    QCOMPARE(spy.count(), 0);
+}
+
+void PowerProfileMonitorTest::followsPowerSaverProfile() {
+    m_powerProfiles.m_activeProfile = QStringLiteral("power-saver");
+
+    auto monitor = createMonitor(BBDX::PowerSavingMode::POWER_SAVING_POWER_SAVER);
+    QTRY_VERIFY(monitor->powerSaving());
+
+    setActiveProfile(QStringLiteral("balanced"));
+    QTRY_VERIFY(!monitor->powerSaving());
+
+    // the battery alone doesn't count in this mode
+    setOnBattery(true);
+    QTest::qWait(200);
+    QVERIFY(!monitor->powerSaving());
+}
+
+void PowerProfileMonitorTest::followsBattery() {
+    auto monitor = createMonitor(BBDX::PowerSavingMode::POWER_SAVING_POWER_SAVER_OR_BATTERY);
+    QSignalSpy spy{monitor.get(), &PowerProfileMonitor::powerSavingChanged};
+
+    setOnBattery(true);
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().first().toBool(), true);
+
+    setOnBattery(false);
+    QTRY_COMPARE(spy.count(), 2);
+    QVERIFY(!monitor->powerSaving());
+}
+
+void PowerProfileMonitorTest::daemonVanishing() {
+    m_powerProfiles.m_activeProfile = QStringLiteral("power-saver");
+
+    auto monitor = createMonitor(BBDX::PowerSavingMode::POWER_SAVING_POWER_SAVER);
+    QTRY_VERIFY(monitor->powerSaving());
+
+    // no daemon means no power saver profile
+    QVERIFY(m_bus.unregisterService(s_powerProfilesService));
+    QTRY_VERIFY(!monitor->powerSaving());
+}
+
+QTEST_GUILESS_MAIN(PowerProfileMonitorTest)
+
+#include "power_profile_monitor_test.moc"
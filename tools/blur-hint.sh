@@ -0,0 +1,24 @@
+#!/bin/sh
+
+# Sets the blur update hint on an X11 window (e.g. inside ./plasma-nested.sh x11).
+# Usage: ./blur-hint.sh [static/low-rate/live/none] [window id]
+# Without a window id the window is picked with the mouse.
+
+atom=_BBDX_NET_WM_BLUR_BEHIND_HINT
+
+if [ -n "$2" ]; then
+    target="-id $2"
+fi
+
+case "$1" in
+    static|low-rate|live)
+        xprop $target -f $atom 8s -set $atom "$1"
+        ;;
+    none)
+        xprop $target -remove $atom
+        ;;
+    *)
+        echo "Usage: $0 [static/low-rate/live/none] [window id]"
+        exit 1
+        ;;
+esac